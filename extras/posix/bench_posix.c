@@ -0,0 +1,209 @@
+/*
+ * Scheduler microbenchmarks for the POSIX host port.
+ *
+ * Runs a periodic task set of each size in tasks[] with each number of
+ * aperiodic jobs in depths[] waiting for the server, and prints one CSV row
+ * per run with the mean host time, in nanoseconds, of:
+ *
+ *   create        xTaskCreatePeriodic()
+ *   delete        vTaskDelete() of a task that is not running
+ *   switch        vTaskSwitchContext()
+ *   tick          xTaskIncrementTick() with no server refill due
+ *   refill_tick   xTaskIncrementTick() giving back server capacity
+ *
+ * and the longest single call of each kind of tick.  Build it like any other
+ * simulation:
+ *
+ *   cc -O2 -Isrc -Iextras/posix src/tasks.c src/list.c src/queue.c src/timers.c
+ *      src/heap_4.c src/stream_buffer.c src/event_groups.c
+ *      extras/posix/port_posix.c extras/posix/bench_posix.c -lm
+ *
+ * and run it with the number of ticks to simulate per run, 10000 by default,
+ * and optionally a baud rate.  Output is thrown away, but with a baud rate
+ * each character waits as long as it would take to send on a board's serial
+ * port, so output made from inside the kernel shows in its times.  The
+ * scheduler can only be started once per process, so every run is made in a
+ * child process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+static const UBaseType_t tasks[] = {1, 2, 4, 8, 16, 32, 64, 128};
+static const UBaseType_t depths[] = {0, 1, 4, 16};
+
+/* Samples of create and delete taken per run. */
+#define BENCH_SAMPLES 64
+
+static char jobParameter[] = "0";
+
+/* Aperiodic jobs ended and not yet replaced. */
+static volatile UBaseType_t aperiodicEnded = 0;
+
+/* Host time to send one character, or 0 to discard output at once. */
+static uint64_t characterTime = 0;
+
+static void sendCharacters(size_t count)
+{
+    uint64_t until = ullPortHostTime() + count * characterTime;
+
+    while (characterTime > 0 && ullPortHostTime() < until)
+    {
+    }
+}
+
+/* Job output is not wanted, only the time taken to schedule the jobs. */
+static void discardString(const char *string)
+{
+    sendCharacters(strlen(string));
+}
+
+static void discardFlashString(const char *string)
+{
+    sendCharacters(strlen(string));
+}
+
+static void discardNumber(int number)
+{
+    char digits[12];
+
+    sendCharacters((size_t)snprintf(digits, sizeof(digits), "%d", number));
+}
+
+static void discardFloat(float number)
+{
+    char digits[32];
+
+    sendCharacters((size_t)snprintf(digits, sizeof(digits), "%f", number));
+}
+
+static void createAperiodic(void)
+{
+    xTaskCreatePeriodic(taskAperiodic, "a", configMINIMAL_STACK_SIZE, jobParameter, APERIODIC_TASK_PRIORITY, NULL,
+                        xTaskGetTickCount(), 0, 1);
+}
+
+static void countAperiodicEnds(uint64_t tick, char event, void *task, TickType_t value)
+{
+    (void)tick;
+    (void)value;
+
+    if (event == 'E' && uxTaskPriorityGet(task) == APERIODIC_TASK_PRIORITY)
+    {
+        aperiodicEnded++;
+    }
+}
+
+/* Replaces every aperiodic job that ended, so the server queue stays at the
+depth of the run.  Creating tasks here is not timed. */
+void vApplicationIdleHook(void)
+{
+    while (aperiodicEnded > 0)
+    {
+        aperiodicEnded--;
+        createAperiodic();
+    }
+}
+
+static double mean(uint64_t total, uint64_t count)
+{
+    return (count == 0) ? 0.0 : (double)total / (double)count;
+}
+
+static void benchRun(UBaseType_t taskCount, UBaseType_t depth, uint64_t ticks)
+{
+    PortKernelCosts_t costs;
+    TaskHandle_t handle;
+    uint64_t createTime = 0, deleteTime = 0, start;
+    UBaseType_t i;
+
+    set_print_str(discardString);
+    set_print_str_P(discardFlashString);
+    set_print_num(discardNumber);
+    set_print_float(discardFloat);
+
+    initialiseServer(2, 5);
+
+    /* Periods are long enough that the set stays at a quarter of the CPU,
+    with phases spread so releases do not all fall on one tick. */
+    for (i = 0; i < taskCount; i++)
+    {
+        start = ullPortHostTime();
+        xTaskCreatePeriodic(taskPeriodic, "p", configMINIMAL_STACK_SIZE, jobParameter, PERIODIC_TASK_PRIORITY, NULL,
+                            i, 4 * taskCount, 1);
+        createTime += ullPortHostTime() - start;
+    }
+
+    for (i = 0; i < depth; i++)
+    {
+        createAperiodic();
+    }
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        xTaskCreatePeriodic(taskPeriodic, "x", configMINIMAL_STACK_SIZE, jobParameter, PERIODIC_TASK_PRIORITY, &handle,
+                            0, 4 * taskCount, 1);
+
+        start = ullPortHostTime();
+        vTaskDelete(handle);
+        deleteTime += ullPortHostTime() - start;
+    }
+
+    vPortSetScheduleHook(countAperiodicEnds);
+    vPortSetTickLimit(ticks);
+    vTaskStartScheduler();
+    vPortGetKernelCosts(&costs);
+
+    printf("%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu\n",
+           (unsigned long)taskCount, (unsigned long)depth,
+           mean(createTime, taskCount), mean(deleteTime, BENCH_SAMPLES),
+           mean(costs.ullSwitchTime, costs.ullSwitches),
+           mean(costs.ullTickTime, costs.ullTicks),
+           mean(costs.ullRefillTickTime, costs.ullRefillTicks),
+           (unsigned long long)costs.ullTickMax, (unsigned long long)costs.ullRefillTickMax,
+           (unsigned long long)costs.ullSwitches, (unsigned long long)costs.ullTicks,
+           (unsigned long long)costs.ullRefillTicks);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t ticks = (argc > 1) ? strtoull(argv[1], NULL, 10) : 10000;
+    size_t t, d;
+
+    /* A start bit, eight data bits and a stop bit per character. */
+    if (argc > 2 && strtoul(argv[2], NULL, 10) > 0)
+    {
+        characterTime = 10 * 1000000000ULL / strtoul(argv[2], NULL, 10);
+    }
+
+    printf("tasks,queue_depth,create_ns,delete_ns,switch_ns,tick_ns,refill_tick_ns,tick_max_ns,refill_tick_max_ns,switches,ticks,refill_ticks\n");
+    fflush(stdout);
+
+    for (t = 0; t < sizeof(tasks) / sizeof(tasks[0]); t++)
+    {
+        for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+        {
+            pid_t child = fork();
+
+            if (child == 0)
+            {
+                benchRun(tasks[t], depths[d], ticks);
+                fflush(stdout);
+                _exit(0);
+            }
+
+            if (child > 0)
+            {
+                waitpid(child, NULL, 0);
+            }
+        }
+    }
+
+    return 0;
+}
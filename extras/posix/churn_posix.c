@@ -0,0 +1,151 @@
+/*
+ * Aperiodic job churn for the POSIX host port.
+ *
+ * Starts the command intake as setup() does, so the command task is the
+ * first task created, then sends a wave of 'a' commands through
+ * commandReceiveFromISR() at the start of every CHURN_WAVE_TICKS ticks, one
+ * command per tick.  Every job of a wave has ended, and deleted itself, well
+ * before the next wave.  At the end of each wave the number of tasks must be
+ * back to what it was when the scheduler started, and the free heap must be
+ * back to what it was after the first wave, as each job's name and parameter
+ * are freed with it.
+ *
+ * Build it like bench_posix.c.  With configUSE_TASK_RECYCLING set to 1 the
+ * jobs of later waves reuse the TCBs and stacks of earlier ones, and the run
+ * also fails if none were reused.  The exit status is the number of checks
+ * that failed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+#define CHURN_WAVES 50
+#define CHURN_JOBS 5
+#define CHURN_WAVE_TICKS 100
+#define CHURN_JOB_DURATION 2
+
+static UBaseType_t startTasks = 0;
+static UBaseType_t leftOver = 0;
+static unsigned wavesLeftOver = 0;
+static unsigned commandsSent = 0;
+static size_t firstWaveHeap = 0;
+static size_t lastWaveHeap = 0;
+
+/*-----------------------------------------------------------*/
+
+static void quietString(const char *string)
+{
+    (void)string;
+}
+
+static void quietNumber(int number)
+{
+    (void)number;
+}
+
+static void quietFloat(float number)
+{
+    (void)number;
+}
+
+static void sendCommand(const char *command)
+{
+    BaseType_t woken = pdFALSE;
+
+    while (*command != '\0')
+    {
+        commandReceiveFromISR(*command++, &woken);
+    }
+}
+
+void vApplicationTickHook(void)
+{
+    TickType_t tick = xTaskGetTickCountFromISR();
+    TickType_t inWave = tick % CHURN_WAVE_TICKS;
+    char command[32];
+
+    /* The first call comes before any command has been sent. */
+    if (startTasks == 0)
+    {
+        startTasks = uxTaskGetNumberOfTasks();
+    }
+
+    /* There is no tick hook call for tick 0, so waves start a tick in. */
+    if (inWave >= 1 && inWave <= CHURN_JOBS)
+    {
+        snprintf(command, sizeof(command), "a j%u w x 0 0 %u\n", (unsigned)inWave, CHURN_JOB_DURATION);
+        sendCommand(command);
+        commandsSent++;
+    }
+    else if (inWave == CHURN_WAVE_TICKS - 1)
+    {
+        if (uxTaskGetNumberOfTasks() != startTasks)
+        {
+            leftOver = uxTaskGetNumberOfTasks() - startTasks;
+            wavesLeftOver++;
+        }
+
+        lastWaveHeap = xPortGetFreeHeapSize();
+
+        if (firstWaveHeap == 0)
+        {
+            firstWaveHeap = lastWaveHeap;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main(void)
+{
+    unsigned failed = 0;
+
+    set_print_str(quietString);
+    set_print_str_P(quietString);
+    set_print_num(quietNumber);
+    set_print_float(quietFloat);
+
+    if (xCommandIntakeStart() != pdPASS)
+    {
+        printf("command intake did not start\n");
+        return 1;
+    }
+
+    vPortSetTickLimit(CHURN_WAVES * CHURN_WAVE_TICKS);
+    vTaskStartScheduler();
+
+    printf("%u waves of %u jobs, %u commands sent\n", CHURN_WAVES, CHURN_JOBS, commandsSent);
+
+    if (wavesLeftOver > 0)
+    {
+        printf("  %u waves ended with tasks left over, %lu after the last\n", wavesLeftOver, (unsigned long)leftOver);
+        failed++;
+    }
+
+    if (lastWaveHeap < firstWaveHeap)
+    {
+        printf("  %lu bytes of heap lost after the first wave\n", (unsigned long)(firstWaveHeap - lastWaveHeap));
+        failed++;
+    }
+
+#if (configUSE_TASK_RECYCLING == 1)
+    {
+        TickType_t latencyMax, latencyLast;
+        UBaseType_t recycled;
+
+        vTaskGetReclaimStats(&latencyMax, &latencyLast, &recycled);
+        printf("%lu tasks recycled, reclaimed at most %lu ticks after deletion\n", (unsigned long)recycled, (unsigned long)latencyMax);
+
+        if (recycled == 0)
+        {
+            printf("  no task was recycled\n");
+            failed++;
+        }
+    }
+#endif
+
+    return (int)failed;
+}
@@ -0,0 +1,535 @@
+/*
+ * Fault injection for the POSIX host port.
+ *
+ * Runs the task set of a scenario file and perturbs it with the faults the
+ * file lists, then reports which tasks missed deadlines and how long the
+ * system took to recover from each fault.  A scenario is a text file of one
+ * directive per line, with '#' starting a comment:
+ *
+ *   run TICKS                     simulate for TICKS virtual ticks (1000)
+ *   > COMMAND                     give COMMAND to parseInput() before the run,
+ *                                 for example "> p t0 w x 0 20 5"
+ *   overrun TASK FROM TO EXTRA    jobs of TASK, or of every task with '*', that
+ *                                 start in ticks FROM to TO - 1 run EXTRA ticks
+ *                                 longer than their duration, or shorter when
+ *                                 EXTRA is negative
+ *   burst AT COUNT DURATION [GAP] COUNT aperiodic jobs of DURATION ticks
+ *                                 arrive from kernel tick AT, GAP ticks apart
+ *   lose FROM TO                  ticks FROM to TO - 1 never reach the kernel
+ *   delay FROM TO                 ticks FROM to TO - 1 are held back, as by a
+ *                                 long interrupt, and reach the kernel at TO
+ *
+ * Ticks are virtual ticks from the start of the run unless said otherwise.
+ * Lost ticks leave the kernel's tick count behind the virtual clock, and the
+ * difference is reported as drift.  A held tick is delivered late together
+ * with the others held with it, so the running job loses the work of those
+ * ticks.
+ *
+ * Deadline misses are the kernel's own, made in kernel time.  Each is blamed
+ * on the latest fault that started at or before it, and those before any
+ * fault are reported apart.  A fault's recovery time is the number of ticks
+ * from its end to the end of the last job blamed on it.  The system has
+ * recovered once every task that missed has since ended a job on time.
+ * Aperiodic response times of burst jobs are in kernel ticks.
+ *
+ * Build it like bench_posix.c, without configUSE_TRACE_RECORDER, and run it
+ * with a scenario file, such as faults_example.txt, or with one on stdin.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+#if (configUSE_TRACE_RECORDER == 1)
+#error faults_posix.c needs the deadline misses the trace recorder takes over
+#endif
+
+#define FAULTS_MAX 32
+#define FAULTS_MAX_TASKS 32
+#define FAULTS_MAX_BURST_JOBS 256
+#define FAULTS_LINE 128
+
+enum faultKind
+{
+    FAULT_OVERRUN,
+    FAULT_BURST,
+    FAULT_LOSE,
+    FAULT_DELAY
+};
+
+static const char *const faultNames[] = {"overrun", "burst", "lose", "delay"};
+
+struct fault
+{
+    enum faultKind kind;
+    char task[configMAX_TASK_NAME_LEN];
+    uint64_t from;
+    uint64_t to;
+    long extra;
+    unsigned count;
+
+    /* What the run blamed on the fault. */
+    unsigned misses;
+    uint64_t lastMiss;
+    uint64_t affected;
+};
+
+/* Every task that ended a job, by name. */
+struct taskRecord
+{
+    char name[configMAX_TASK_NAME_LEN];
+    unsigned jobs;
+    unsigned misses;
+    TickType_t worstLateness;
+    uint64_t lastMiss;
+    int lastJobLate;
+    int missPending;
+};
+
+static struct fault faults[FAULTS_MAX];
+static unsigned faultCount;
+static struct taskRecord records[FAULTS_MAX_TASKS];
+static unsigned recordCount;
+static unsigned baselineMisses;
+
+static TickType_t burstArrival[FAULTS_MAX_BURST_JOBS];
+static TickType_t burstResponse[FAULTS_MAX_BURST_JOBS];
+static unsigned burstJobs;
+
+static uint64_t run = 1000;
+static unsigned heldTicks;
+static unsigned lostTicks;
+static int rejected;
+
+/*-----------------------------------------------------------*/
+
+static void captureString(const char *string)
+{
+    (void)string;
+}
+
+static void captureFlashString(const char *string)
+{
+    if (strstr(string, "Cant") != NULL)
+    {
+        rejected = 1;
+    }
+}
+
+static void captureNumber(int number)
+{
+    (void)number;
+}
+
+static void captureFloat(float number)
+{
+    (void)number;
+}
+
+/*-----------------------------------------------------------*/
+
+static struct taskRecord *findRecord(const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < recordCount; i++)
+    {
+        if (strcmp(records[i].name, name) == 0)
+        {
+            return &records[i];
+        }
+    }
+
+    if (recordCount == FAULTS_MAX_TASKS)
+    {
+        return NULL;
+    }
+
+    strncpy(records[recordCount].name, name, configMAX_TASK_NAME_LEN - 1);
+
+    return &records[recordCount++];
+}
+
+/* The latest fault started at or before tick, or NULL. */
+static struct fault *blame(uint64_t tick)
+{
+    struct fault *latest = NULL;
+    unsigned i;
+
+    for (i = 0; i < faultCount; i++)
+    {
+        if (faults[i].from <= tick && (latest == NULL || faults[i].from >= latest->from))
+        {
+            latest = &faults[i];
+        }
+    }
+
+    return latest;
+}
+
+static TickType_t jobFault(void *task, TickType_t duration)
+{
+    const char *name = pcTaskGetName(task);
+    uint64_t tick = ullPortGetTicks();
+    long length = (long)duration;
+    unsigned i;
+
+    for (i = 0; i < faultCount; i++)
+    {
+        const struct fault *f = &faults[i];
+
+        if (f->kind == FAULT_OVERRUN && tick >= f->from && tick < f->to &&
+            (strcmp(f->task, "*") == 0 || strcmp(f->task, name) == 0))
+        {
+            length += f->extra;
+        }
+    }
+
+    return (TickType_t)((length < 1) ? 1 : length);
+}
+
+static UBaseType_t tickFault(uint64_t tick)
+{
+    UBaseType_t increments;
+    unsigned i;
+
+    for (i = 0; i < faultCount; i++)
+    {
+        if (faults[i].kind == FAULT_LOSE && tick >= faults[i].from && tick < faults[i].to)
+        {
+            lostTicks++;
+            return 0;
+        }
+    }
+
+    for (i = 0; i < faultCount; i++)
+    {
+        if (faults[i].kind == FAULT_DELAY && tick >= faults[i].from && tick < faults[i].to)
+        {
+            heldTicks++;
+            return 0;
+        }
+    }
+
+    increments = 1 + heldTicks;
+    heldTicks = 0;
+
+    return increments;
+}
+
+static void recordEvent(uint64_t tick, char event, void *task, TickType_t value)
+{
+    const char *name;
+    struct taskRecord *record;
+
+    if (event != 'D' && event != 'E')
+    {
+        return;
+    }
+
+    name = pcTaskGetName(task);
+
+    /* Burst jobs are aperiodic and named b<index>. */
+    if (name[0] == 'b' && name[1] >= '0' && name[1] <= '9')
+    {
+        unsigned index = (unsigned)atoi(name + 1);
+
+        if (event == 'E' && index < burstJobs)
+        {
+            burstResponse[index] = (TickType_t)(xTaskGetTickCount() - burstArrival[index]);
+        }
+        return;
+    }
+
+    record = findRecord(name);
+
+    if (record == NULL)
+    {
+        return;
+    }
+
+    if (event == 'D')
+    {
+        /* The job ends in the same tick, after this. */
+        TickType_t lateness = (TickType_t)(xTaskGetTickCount() + 1 - value);
+        struct fault *f = blame(tick);
+
+        record->misses++;
+        record->lastMiss = tick;
+        record->missPending = 1;
+
+        if (lateness > record->worstLateness)
+        {
+            record->worstLateness = lateness;
+        }
+
+        if (f == NULL)
+        {
+            baselineMisses++;
+        }
+        else
+        {
+            f->misses++;
+            f->lastMiss = tick;
+            f->affected |= 1ULL << (record - records);
+        }
+    }
+    else
+    {
+        record->jobs++;
+        record->lastJobLate = record->missPending;
+        record->missPending = 0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int parseScenario(FILE *in)
+{
+    char line[FAULTS_LINE], command[FAULTS_LINE];
+    unsigned number = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        struct fault *f = &faults[faultCount];
+        char *comment = strchr(line, '#');
+        char *text = line;
+        char word[16];
+        unsigned long long from = 0, to = 0;
+        unsigned long duration = 0, gap = 0;
+        long extra = 0;
+        int fields;
+
+        number++;
+
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        text[strcspn(text, "\r\n")] = '\0';
+        text += strspn(text, " \t");
+
+        if (*text == '\0')
+        {
+            continue;
+        }
+
+        if (*text == '>')
+        {
+            text++;
+            text += strspn(text, " \t");
+            strcpy(command, text);
+
+            rejected = 0;
+            parseInput(command);
+
+            if (rejected)
+            {
+                fprintf(stderr, "line %u: command rejected: %s\n", number, text);
+            }
+            continue;
+        }
+
+        if (sscanf(text, "%15s", word) != 1)
+        {
+            continue;
+        }
+
+        if (strcmp(word, "run") == 0 && sscanf(text, "%*s %llu", &from) == 1)
+        {
+            run = from;
+            continue;
+        }
+
+        if (faultCount == FAULTS_MAX)
+        {
+            fprintf(stderr, "line %u: more than %d faults\n", number, FAULTS_MAX);
+            return 0;
+        }
+
+        memset(f, 0, sizeof(*f));
+
+        if (strcmp(word, "overrun") == 0)
+        {
+            char task[FAULTS_LINE];
+
+            fields = sscanf(text, "%*s %127s %llu %llu %ld", task, &from, &to, &extra);
+            f->kind = FAULT_OVERRUN;
+            snprintf(f->task, sizeof(f->task), "%.*s", (int)sizeof(f->task) - 1, task);
+            fields = (fields == 4);
+        }
+        else if (strcmp(word, "burst") == 0)
+        {
+            unsigned long count = 0, i;
+
+            fields = sscanf(text, "%*s %llu %lu %lu %lu", &from, &count, &duration, &gap);
+            f->kind = FAULT_BURST;
+            f->count = (unsigned)count;
+            to = from + ((count > 0) ? (count - 1) * gap : 0) + 1;
+            fields = (fields >= 3 && burstJobs + count <= FAULTS_MAX_BURST_JOBS);
+
+            for (i = 0; fields && i < count; i++)
+            {
+                burstArrival[burstJobs] = (TickType_t)(from + i * gap);
+                snprintf(command, sizeof(command), "a b%u w x %lu 0 %lu", burstJobs, (unsigned long)burstArrival[burstJobs], duration);
+                parseInput(command);
+                burstJobs++;
+            }
+        }
+        else if (strcmp(word, "lose") == 0 || strcmp(word, "delay") == 0)
+        {
+            fields = (sscanf(text, "%*s %llu %llu", &from, &to) == 2);
+            f->kind = (word[0] == 'l') ? FAULT_LOSE : FAULT_DELAY;
+        }
+        else
+        {
+            fields = 0;
+        }
+
+        if (!fields || to <= from)
+        {
+            fprintf(stderr, "line %u: cannot read: %s\n", number, text);
+            return 0;
+        }
+
+        f->from = from;
+        f->to = to;
+        f->extra = extra;
+        faultCount++;
+    }
+
+    return 1;
+}
+
+/*-----------------------------------------------------------*/
+
+static void reportFault(const struct fault *f)
+{
+    unsigned i;
+    int recovered = 1;
+
+    printf("%-8s", faultNames[f->kind]);
+
+    switch (f->kind)
+    {
+    case FAULT_OVERRUN:
+        printf("%s %+ld", f->task, f->extra);
+        break;
+    case FAULT_BURST:
+        printf("%u jobs", f->count);
+        break;
+    default:
+        break;
+    }
+
+    printf(" at %llu-%llu: %u misses", (unsigned long long)f->from, (unsigned long long)f->to - 1, f->misses);
+
+    if (f->misses == 0)
+    {
+        printf("\n");
+        return;
+    }
+
+    printf(" by");
+
+    for (i = 0; i < recordCount; i++)
+    {
+        if (f->affected & (1ULL << i))
+        {
+            printf(" %s", records[i].name);
+
+            /* A task recovers by ending a job on time after its last miss. */
+            if (blame(records[i].lastMiss) == f && (records[i].lastJobLate || records[i].missPending))
+            {
+                recovered = 0;
+            }
+        }
+    }
+
+    if (f->to > run)
+    {
+        printf(", still active at the end of the run\n");
+    }
+    else if (!recovered)
+    {
+        printf(", not recovered by the end of the run\n");
+    }
+    else
+    {
+        printf(", recovered %llu ticks after it ended\n",
+               (unsigned long long)((f->lastMiss + 1 > f->to) ? f->lastMiss + 1 - f->to : 0));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    TickType_t drift;
+    unsigned i, served = 0;
+    unsigned long responseSum = 0;
+    TickType_t responseMax = 0;
+
+    set_print_str(captureString);
+    set_print_str_P(captureFlashString);
+    set_print_num(captureNumber);
+    set_print_float(captureFloat);
+
+    if (argc > 1 && (in = fopen(argv[1], "r")) == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (!parseScenario(in))
+    {
+        return 1;
+    }
+
+    vPortSetScheduleHook(recordEvent);
+    vPortSetFaultHooks(jobFault, tickFault);
+    vPortSetTickLimit(run);
+    vTaskStartScheduler();
+
+    drift = (TickType_t)(ullPortGetTicks() - 1) - xTaskGetTickCount();
+
+    printf("%llu ticks, %u lost, kernel clock %lu ticks behind\n", (unsigned long long)run, lostTicks, (unsigned long)drift);
+    printf("before any fault: %u misses\n", baselineMisses);
+
+    for (i = 0; i < faultCount; i++)
+    {
+        reportFault(&faults[i]);
+    }
+
+    printf("\ntask      jobs  misses  worst_lateness\n");
+
+    for (i = 0; i < recordCount; i++)
+    {
+        printf("%-8s %5u  %6u  %14lu\n", records[i].name, records[i].jobs, records[i].misses, (unsigned long)records[i].worstLateness);
+    }
+
+    for (i = 0; i < burstJobs; i++)
+    {
+        if (burstResponse[i] != 0)
+        {
+            served++;
+            responseSum += burstResponse[i];
+
+            if (burstResponse[i] > responseMax)
+            {
+                responseMax = burstResponse[i];
+            }
+        }
+    }
+
+    if (burstJobs > 0)
+    {
+        printf("\nburst jobs: %u released, %u served, response mean %.1f max %lu\n", burstJobs, served,
+               (served > 0) ? (double)responseSum / served : 0.0, (unsigned long)responseMax);
+    }
+
+    return 0;
+}
@@ -0,0 +1,551 @@
+/*
+ * Golden schedule check for the POSIX host port.
+ *
+ * Runs reference task sets on the kernel and compares each run with a
+ * schedule worked out here, tick by tick, without any code from tasks.c.
+ * The sets are textbook sporadic server examples, critical-instant sets
+ * with every task released at tick 0, and overload sets that the admission
+ * test would refuse.  The reference schedule follows these rules:
+ *
+ *   - A periodic job is released at arrival + k * period, where k is the
+ *     number of jobs of the task that have ended, so a late job holds back
+ *     the next one rather than being dropped.
+ *   - Among released periodic jobs the one with the shortest period runs.
+ *   - The server runs the earliest aperiodic job that has arrived while it
+ *     has capacity and its period is shorter than that of every released
+ *     periodic job.  Each tick it serves takes one tick of capacity.
+ *   - When the server first runs a job, the job's duration is scheduled to
+ *     be given back one server period later.  With two refills already
+ *     pending, it is added to the later one instead, which moves to the new
+ *     refill's tick.
+ *
+ * Each job start and end, and each refill scheduled and given back, is an
+ * event.  Events of the run are matched with those of the reference by task
+ * and job number, and refills by their order, and every one that differs in
+ * its tick or amount, or is missing from either side, is printed.  The exit
+ * status is the number of sets that differed.
+ *
+ * Build it like bench_posix.c, without configUSE_TRACE_BUFFER, and run it
+ * with no arguments for every set or with the names of the sets to run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+#if (configUSE_TRACE_BUFFER == 1)
+#error golden_posix.c needs the job output the trace buffer takes over
+#endif
+
+#define GOLDEN_MAX_TASKS 8
+#define GOLDEN_MAX_TICKS 256
+#define GOLDEN_MAX_EVENTS (4 * GOLDEN_MAX_TICKS)
+#define GOLDEN_MAX_REFILLS 2
+
+struct goldenTask
+{
+    char kind; /* 'p' for periodic and 'a' for aperiodic. */
+    const char *name;
+    TickType_t arrival;
+    TickType_t period;
+    TickType_t duration;
+};
+
+struct goldenSet
+{
+    const char *name;
+    TickType_t capacity;
+    TickType_t serverPeriod;
+    unsigned ticks;
+    struct goldenTask tasks[GOLDEN_MAX_TASKS];
+};
+
+/* Periods within a set differ, as the kernel breaks ties between equal
+periods by list order. */
+static const struct goldenSet sets[] = {
+    /* Server with the shortest period, serving jobs that fit its capacity,
+    one that waits for a refill, and one that arrives mid-job. */
+    {"ss-high", 2, 5, 60, {
+        {'p', "t1", 0, 10, 3},
+        {'p', "t2", 0, 20, 4},
+        {'a', "a1", 1, 0, 1},
+        {'a', "a2", 3, 0, 2},
+        {'a', "a3", 4, 0, 1},
+        {'a', "a4", 22, 0, 2},
+    }},
+    /* Server between two periodic tasks, so the shorter one preempts it. */
+    {"ss-middle", 3, 8, 80, {
+        {'p', "t1", 0, 4, 1},
+        {'p', "t2", 0, 16, 5},
+        {'a', "a1", 2, 0, 2},
+        {'a', "a2", 9, 0, 3},
+        {'a', "a3", 30, 0, 1},
+    }},
+    /* Server below every periodic task, running in their idle time. */
+    {"ss-low", 2, 12, 60, {
+        {'p', "t1", 0, 5, 2},
+        {'p', "t2", 1, 10, 3},
+        {'a', "a1", 0, 0, 2},
+        {'a', "a2", 6, 0, 1},
+    }},
+    /* Liu and Layland: released together, the lowest priority task ends
+    exactly at its deadline. */
+    {"critical-instant", 0, 100, 96, {
+        {'p', "t1", 0, 4, 1},
+        {'p', "t2", 0, 6, 2},
+        {'p', "t3", 0, 12, 3},
+    }},
+    /* Harmonic periods at full utilisation. */
+    {"critical-harmonic", 0, 100, 64, {
+        {'p', "t1", 0, 4, 2},
+        {'p', "t2", 0, 8, 2},
+        {'p', "t3", 0, 16, 4},
+    }},
+    /* Utilisation 1.2: the lowest priority task falls ever further behind. */
+    {"overload-periodic", 0, 100, 60, {
+        {'p', "t1", 0, 4, 2},
+        {'p', "t2", 0, 6, 3},
+        {'p', "t3", 0, 10, 2},
+    }},
+    /* Aperiodic work beyond the server's capacity, with a job longer than
+    the capacity that runs across a refill. */
+    {"overload-server", 2, 6, 80, {
+        {'p', "t1", 0, 12, 3},
+        {'a', "a1", 0, 0, 3},
+        {'a', "a2", 1, 0, 1},
+        {'a', "a3", 2, 0, 2},
+        {'a', "a4", 2, 0, 1},
+    }},
+    /* More short jobs in a server period than there are refill slots, then
+    a job that needs the whole capacity back. */
+    {"burst-server", 3, 10, 60, {
+        {'p', "t1", 0, 20, 2},
+        {'a', "a1", 0, 0, 1},
+        {'a', "a2", 1, 0, 1},
+        {'a', "a3", 2, 0, 1},
+        {'a', "a4", 13, 0, 3},
+    }},
+};
+
+#define GOLDEN_SETS (sizeof(sets) / sizeof(sets[0]))
+
+struct goldenEvent
+{
+    char kind; /* 'S' job start, 'E' job end, 'F' refill scheduled, 'R' refill given back. */
+    int task;  /* Index into the set's tasks, or -1 for refills. */
+    unsigned number;
+    unsigned long tick;
+    TickType_t amount;
+};
+
+struct goldenTrace
+{
+    struct goldenEvent events[GOLDEN_MAX_EVENTS];
+    unsigned count;
+    unsigned refillsSet;
+    unsigned refillsGiven;
+};
+
+static const struct goldenSet *set;
+static struct goldenTrace kernel;
+static struct goldenTrace reference;
+
+/* Task that ran in each tick of the kernel run, plus one, or 0 for none. */
+static unsigned char kernelRan[GOLDEN_MAX_TICKS];
+
+/* Task whose job output is waiting for its tick number. */
+static int outputTask = -1;
+
+/*-----------------------------------------------------------*/
+
+static void addEvent(struct goldenTrace *trace, char kind, int task, unsigned number, unsigned long tick, TickType_t amount)
+{
+    struct goldenEvent *event;
+
+    if (trace->count == GOLDEN_MAX_EVENTS || tick >= set->ticks)
+    {
+        return;
+    }
+
+    event = &trace->events[trace->count++];
+    event->kind = kind;
+    event->task = task;
+    event->number = number;
+    event->tick = tick;
+    event->amount = amount;
+}
+
+static void addRefill(struct goldenTrace *trace, char kind, unsigned long tick, TickType_t amount)
+{
+    unsigned *number = (kind == 'F') ? &trace->refillsSet : &trace->refillsGiven;
+
+    addEvent(trace, kind, -1, (*number)++, tick, amount);
+}
+
+/* Turns the task run in each tick into job starts and ends. */
+static void addJobs(struct goldenTrace *trace, const unsigned char *ran)
+{
+    TickType_t executed[GOLDEN_MAX_TASKS] = {0};
+    unsigned jobs[GOLDEN_MAX_TASKS] = {0};
+    unsigned long tick;
+
+    for (tick = 0; tick < set->ticks; tick++)
+    {
+        int task = (int)ran[tick] - 1;
+
+        if (task < 0)
+        {
+            continue;
+        }
+
+        if (executed[task] == 0)
+        {
+            addEvent(trace, 'S', task, jobs[task], tick, 0);
+        }
+
+        if (++executed[task] == set->tasks[task].duration)
+        {
+            addEvent(trace, 'E', task, jobs[task], tick + 1, 0);
+            executed[task] = 0;
+            jobs[task]++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Job output is the task's parameter, which is its name in sets[], followed
+by the tick. */
+static void captureString(const char *string)
+{
+    unsigned i;
+
+    outputTask = -1;
+
+    for (i = 0; i < GOLDEN_MAX_TASKS && set->tasks[i].name != NULL; i++)
+    {
+        if (string == set->tasks[i].name)
+        {
+            outputTask = (int)i;
+        }
+    }
+}
+
+static void captureFlashString(const char *string)
+{
+    (void)string;
+    outputTask = -1;
+}
+
+static void captureNumber(int number)
+{
+    if (outputTask >= 0 && number >= 0 && number < GOLDEN_MAX_TICKS)
+    {
+        kernelRan[number] = (unsigned char)(outputTask + 1);
+    }
+    outputTask = -1;
+}
+
+static void captureFloat(float number)
+{
+    (void)number;
+}
+
+static void captureRefill(uint64_t tick, char event, void *task, TickType_t value)
+{
+    (void)task;
+
+    if (event == 'F' || event == 'R')
+    {
+        addRefill(&kernel, event, (unsigned long)tick, value);
+    }
+}
+
+static void kernelRun(void)
+{
+    unsigned i;
+
+    set_print_str(captureString);
+    set_print_str_P(captureFlashString);
+    set_print_num(captureNumber);
+    set_print_float(captureFloat);
+
+    initialiseServer(set->capacity, set->serverPeriod);
+
+    for (i = 0; i < GOLDEN_MAX_TASKS && set->tasks[i].name != NULL; i++)
+    {
+        const struct goldenTask *task = &set->tasks[i];
+
+        xTaskCreatePeriodic((task->kind == 'p') ? taskPeriodic : taskAperiodic, task->name, configMINIMAL_STACK_SIZE,
+                            (void *)task->name, (task->kind == 'p') ? PERIODIC_TASK_PRIORITY : APERIODIC_TASK_PRIORITY,
+                            NULL, task->arrival, task->period, task->duration);
+    }
+
+    vPortSetScheduleHook(captureRefill);
+    vPortSetTickLimit(set->ticks);
+    vTaskStartScheduler();
+
+    addJobs(&kernel, kernelRan);
+}
+
+/*-----------------------------------------------------------*/
+
+/* The schedule the rules at the top of this file make for the set. */
+static void referenceRun(void)
+{
+    unsigned char ran[GOLDEN_MAX_TICKS] = {0};
+    TickType_t remaining[GOLDEN_MAX_TASKS];
+    unsigned ended[GOLDEN_MAX_TASKS] = {0};
+    int served[GOLDEN_MAX_TASKS] = {0};
+    unsigned long refillTick[GOLDEN_MAX_EVENTS];
+    TickType_t refillAmount[GOLDEN_MAX_EVENTS];
+    unsigned refills = 0, given = 0;
+    TickType_t capacity = set->capacity;
+    unsigned long tick;
+    unsigned count, i;
+
+    for (count = 0; count < GOLDEN_MAX_TASKS && set->tasks[count].name != NULL; count++)
+    {
+        remaining[count] = set->tasks[count].duration;
+    }
+
+    for (tick = 0; tick < set->ticks; tick++)
+    {
+        const struct goldenTask *task;
+        int chosen = -1;
+
+        /* Refills are scheduled in tick order, one server period apart. */
+        while (given < refills && refillTick[given] == tick)
+        {
+            capacity += refillAmount[given];
+            addRefill(&reference, 'R', tick, refillAmount[given]);
+            given++;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            task = &set->tasks[i];
+
+            if (task->kind == 'p' && task->arrival + ended[i] * task->period <= tick &&
+                (chosen < 0 || task->period < set->tasks[chosen].period))
+            {
+                chosen = (int)i;
+            }
+        }
+
+        if (capacity > 0 && (chosen < 0 || set->serverPeriod < set->tasks[chosen].period))
+        {
+            int earliest = -1;
+
+            for (i = 0; i < count; i++)
+            {
+                task = &set->tasks[i];
+
+                if (task->kind == 'a' && ended[i] == 0 && task->arrival <= tick &&
+                    (earliest < 0 || task->arrival < set->tasks[earliest].arrival))
+                {
+                    earliest = (int)i;
+                }
+            }
+
+            if (earliest >= 0)
+            {
+                chosen = earliest;
+
+                if (served[chosen] == 0 && refills - given == GOLDEN_MAX_REFILLS)
+                {
+                    served[chosen] = 1;
+                    refillTick[refills - 1] = tick + set->serverPeriod;
+                    refillAmount[refills - 1] += set->tasks[chosen].duration;
+                    addRefill(&reference, 'F', tick, set->tasks[chosen].duration);
+                }
+                else if (served[chosen] == 0 && refills < GOLDEN_MAX_EVENTS)
+                {
+                    served[chosen] = 1;
+                    refillTick[refills] = tick + set->serverPeriod;
+                    refillAmount[refills] = set->tasks[chosen].duration;
+                    refills++;
+                    addRefill(&reference, 'F', tick, set->tasks[chosen].duration);
+                }
+                capacity--;
+            }
+        }
+
+        if (chosen < 0)
+        {
+            continue;
+        }
+
+        ran[tick] = (unsigned char)(chosen + 1);
+
+        if (--remaining[chosen] == 0)
+        {
+            remaining[chosen] = set->tasks[chosen].duration;
+            ended[chosen]++;
+        }
+    }
+
+    addJobs(&reference, ran);
+}
+
+/*-----------------------------------------------------------*/
+
+static const struct goldenEvent *findEvent(const struct goldenTrace *trace, const struct goldenEvent *event)
+{
+    unsigned i;
+
+    for (i = 0; i < trace->count; i++)
+    {
+        const struct goldenEvent *other = &trace->events[i];
+
+        if (other->kind == event->kind && other->task == event->task && other->number == event->number)
+        {
+            return other;
+        }
+    }
+
+    return NULL;
+}
+
+static void printEvent(const struct goldenEvent *event)
+{
+    switch (event->kind)
+    {
+    case 'S':
+        printf("%s job %u start", set->tasks[event->task].name, event->number);
+        break;
+    case 'E':
+        printf("%s job %u end", set->tasks[event->task].name, event->number);
+        break;
+    case 'F':
+        printf("refill %u scheduled", event->number);
+        break;
+    default:
+        printf("refill %u given back", event->number);
+        break;
+    }
+}
+
+/* Prints every event that is missing from the run or differs from the
+reference, and returns how many there were. */
+static unsigned compare(void)
+{
+    unsigned differences = 0;
+    unsigned i;
+
+    for (i = 0; i < reference.count; i++)
+    {
+        const struct goldenEvent *expected = &reference.events[i];
+        const struct goldenEvent *actual = findEvent(&kernel, expected);
+
+        if (actual != NULL && actual->tick == expected->tick && actual->amount == expected->amount)
+        {
+            continue;
+        }
+
+        differences++;
+        printf("  ");
+        printEvent(expected);
+
+        if (actual == NULL)
+        {
+            printf(": reference %lu, missing from the run", expected->tick);
+        }
+        else
+        {
+            printf(": reference %lu, run %lu", expected->tick, actual->tick);
+        }
+
+        if (expected->kind == 'F' || expected->kind == 'R')
+        {
+            printf(", amount %lu", (unsigned long)expected->amount);
+
+            if (actual != NULL && actual->amount != expected->amount)
+            {
+                printf(" in the reference and %lu in the run", (unsigned long)actual->amount);
+            }
+        }
+        printf("\n");
+    }
+
+    for (i = 0; i < kernel.count; i++)
+    {
+        const struct goldenEvent *actual = &kernel.events[i];
+
+        if (findEvent(&reference, actual) == NULL)
+        {
+            differences++;
+            printf("  ");
+            printEvent(actual);
+            printf(": run %lu, missing from the reference\n", actual->tick);
+        }
+    }
+
+    return differences;
+}
+
+static int checkSet(const struct goldenSet *checked)
+{
+    unsigned differences;
+
+    set = checked;
+    kernelRun();
+    referenceRun();
+
+    differences = compare();
+
+    printf("%-18s %u events, %u differences\n", set->name, reference.count, differences);
+
+    return differences != 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned failed = 0;
+    size_t i;
+    int a;
+
+    for (i = 0; i < GOLDEN_SETS; i++)
+    {
+        int wanted = (argc == 1);
+        int status;
+        pid_t child;
+
+        for (a = 1; a < argc; a++)
+        {
+            wanted |= (strcmp(argv[a], sets[i].name) == 0);
+        }
+
+        if (!wanted)
+        {
+            continue;
+        }
+
+        /* The scheduler can only be started once per process. */
+        fflush(stdout);
+        child = fork();
+
+        if (child == 0)
+        {
+            status = checkSet(&sets[i]);
+            fflush(stdout);
+            _exit(status);
+        }
+
+        if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if (child < 0 || !WIFEXITED(status))
+            {
+                printf("%-18s did not run to the end\n", sets[i].name);
+            }
+            failed++;
+        }
+    }
+
+    return (int)failed;
+}
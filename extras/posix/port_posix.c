@@ -0,0 +1,479 @@
+/*
+ * FreeRTOS Kernel V10.2.0
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the POSIX host
+ * simulator.  The kernel sources are built unchanged with this file, the
+ * src directory and this directory on the include path, for example:
+ *
+ *   cc -Isrc -Iextras/posix src/tasks.c src/list.c src/queue.c src/timers.c
+ *      src/heap_4.c src/stream_buffer.c src/event_groups.c
+ *      extras/posix/port_posix.c simulation.c
+ *
+ * Every task runs as a ucontext coroutine on a host stack of its own, found
+ * from the top of its FreeRTOS stack, which the simulator never writes.
+ *----------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+/* Host stack given to every task.  Job code runs on it, not on the FreeRTOS
+stack, so it must hold the host C library's needs. */
+#define portHOST_STACK_SIZE             ( 64 * 1024 )
+
+/* Buckets of the table that maps FreeRTOS stacks to host contexts. */
+#define portCONTEXT_BUCKETS             ( 1024 )
+
+/*-----------------------------------------------------------*/
+
+/* We require the address of the pxCurrentTCB variable, but don't want to know
+any details of its type. */
+typedef void TCB_t;
+extern volatile TCB_t * volatile pxCurrentTCB;
+
+typedef struct HostContext
+{
+    StackType_t *pxTopOfStack;      /*< Top of the task's FreeRTOS stack, the key of the context. */
+    ucontext_t xContext;
+    void *pvHostStack;
+    TaskFunction_t pxCode;
+    void *pvParameters;
+    UBaseType_t uxCriticalNesting;  /*< Interrupt state of the task while it is switched out. */
+    BaseType_t xInterruptsEnabled;
+    BaseType_t xRestarted;          /*< Set until the task next starts from pxCode. */
+    struct HostContext *pxNext;
+} HostContext_t;
+
+static HostContext_t *pxContexts[ portCONTEXT_BUCKETS ];
+
+/* Context of the program that called vTaskStartScheduler(). */
+static ucontext_t xSchedulerContext;
+
+/* Simulated interrupt state of the running task. */
+static UBaseType_t uxCriticalNesting = 0;
+static BaseType_t xInterruptsEnabled = pdTRUE;
+
+static uint64_t ullTicks = 0;
+static uint64_t ullTickLimit = 0;
+
+static PortScheduleHook_t pxScheduleHook = NULL;
+static PortJobFaultHook_t pxJobFaultHook = NULL;
+static PortTickFaultHook_t pxTickFaultHook = NULL;
+
+static PortKernelCosts_t xCosts;
+static BaseType_t xRefillInTick = pdFALSE;
+
+/* Erased EEPROM reads as 0xFF. */
+uint8_t ucPortEEPROM[ portEEPROM_SIZE ] = { [ 0 ... portEEPROM_SIZE - 1 ] = 0xFF };
+
+/*-----------------------------------------------------------*/
+
+static HostContext_t **prvContextSlot( StackType_t *pxTopOfStack )
+{
+HostContext_t **ppxSlot = &pxContexts[ ( ( uintptr_t ) pxTopOfStack / sizeof( StackType_t ) ) % portCONTEXT_BUCKETS ];
+
+    while( ( *ppxSlot != NULL ) && ( ( *ppxSlot )->pxTopOfStack != pxTopOfStack ) )
+    {
+        ppxSlot = &( ( *ppxSlot )->pxNext );
+    }
+
+    return ppxSlot;
+}
+/*-----------------------------------------------------------*/
+
+/* The kernel never moves pxTopOfStack, the first member of a TCB, after it
+is initialised, so it identifies the running task's context. */
+static HostContext_t *prvCurrentContext( void )
+{
+    return *prvContextSlot( *( StackType_t * volatile * ) pxCurrentTCB );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskEntry( void )
+{
+HostContext_t *pxContext = prvCurrentContext();
+
+    pxContext->xRestarted = pdFALSE;
+    uxCriticalNesting = 0;
+    xInterruptsEnabled = pdTRUE;
+
+    pxContext->pxCode( pxContext->pvParameters );
+
+    /* Tasks must not return. */
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+/* Switches from the context that was running to the one vTaskSwitchContext()
+chose.  Returns when the old context is next chosen. */
+static void prvSwitchContext( HostContext_t *pxOld )
+{
+HostContext_t *pxNew = prvCurrentContext();
+
+    if( pxOld->xRestarted != pdFALSE )
+    {
+        /* A periodic job ended and its task was made to start again from
+        pxCode, so what was running is not resumed. */
+        setcontext( &( pxNew->xContext ) );
+    }
+
+    if( pxOld == pxNew )
+    {
+        return;
+    }
+
+    pxOld->uxCriticalNesting = uxCriticalNesting;
+    pxOld->xInterruptsEnabled = xInterruptsEnabled;
+
+    swapcontext( &( pxOld->xContext ), &( pxNew->xContext ) );
+
+    uxCriticalNesting = pxOld->uxCriticalNesting;
+    xInterruptsEnabled = pxOld->xInterruptsEnabled;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+StackType_t *pxPortInitialiseStack( StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters )
+{
+HostContext_t **ppxSlot = prvContextSlot( pxTopOfStack );
+HostContext_t *pxContext = *ppxSlot;
+
+    /* A task restarted at the end of a job keeps its host stack. */
+    if( pxContext == NULL )
+    {
+        pxContext = ( HostContext_t * ) malloc( sizeof( HostContext_t ) );
+        configASSERT( pxContext != NULL );
+        pxContext->pvHostStack = malloc( portHOST_STACK_SIZE );
+        configASSERT( pxContext->pvHostStack != NULL );
+        pxContext->pxTopOfStack = pxTopOfStack;
+        pxContext->pxNext = NULL;
+        *ppxSlot = pxContext;
+    }
+
+    pxContext->pxCode = pxCode;
+    pxContext->pvParameters = pvParameters;
+    pxContext->uxCriticalNesting = 0;
+    pxContext->xInterruptsEnabled = pdTRUE;
+    pxContext->xRestarted = pdTRUE;
+
+    getcontext( &( pxContext->xContext ) );
+    pxContext->xContext.uc_stack.ss_sp = pxContext->pvHostStack;
+    pxContext->xContext.uc_stack.ss_size = portHOST_STACK_SIZE;
+    pxContext->xContext.uc_link = NULL;
+    makecontext( &( pxContext->xContext ), prvTaskEntry, 0 );
+
+    return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+void vPortCleanUpTCB( void *pxTCB )
+{
+HostContext_t **ppxSlot = prvContextSlot( *( StackType_t ** ) pxTCB );
+HostContext_t *pxContext = *ppxSlot;
+
+    /* Only tasks that are not running are deleted. */
+    if( pxContext != NULL )
+    {
+        *ppxSlot = pxContext->pxNext;
+        free( pxContext->pvHostStack );
+        free( pxContext );
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullPortHostTime( void )
+{
+struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( uint64_t ) xNow.tv_sec * 1000000000ULL + ( uint64_t ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+/* Calls vTaskSwitchContext(), adding its cost to the totals. */
+static void prvTimedSwitchContext( void )
+{
+uint64_t ullStart = ullPortHostTime();
+
+    vTaskSwitchContext();
+
+    xCosts.ullSwitchTime += ullPortHostTime() - ullStart;
+    xCosts.ullSwitches++;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortStartScheduler( void )
+{
+    ullTicks = 0;
+    memset( &xCosts, 0, sizeof( xCosts ) );
+
+    swapcontext( &xSchedulerContext, &( prvCurrentContext()->xContext ) );
+
+    /* Only reached once vTaskEndScheduler() has been called. */
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+    /* The running task is abandoned along with the rest. */
+    setcontext( &xSchedulerContext );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Manual context switch.
+ */
+void vPortYield( void )
+{
+HostContext_t *pxOld = prvCurrentContext();
+
+    prvTimedSwitchContext();
+    prvSwitchContext( pxOld );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The tick interrupt.  A task spinning until the tick count changes has
+ * nothing else to do in this tick, so the virtual clock moves to the next.
+ */
+void vPortSpinWait( void )
+{
+HostContext_t *pxOld;
+BaseType_t xSwitchRequired = pdFALSE;
+UBaseType_t uxIncrements;
+uint64_t ullStart, ullTime;
+
+    if( ( xInterruptsEnabled == pdFALSE ) || ( uxCriticalNesting > 0 ) )
+    {
+        return;
+    }
+
+    ullTicks++;
+
+    if( ( ullTickLimit != 0 ) && ( ullTicks > ullTickLimit ) )
+    {
+        vTaskEndScheduler();
+    }
+
+    uxIncrements = ( pxTickFaultHook != NULL ) ? pxTickFaultHook( ullTicks ) : 1;
+
+    /* A lost tick leaves the spinning task to spin into the next one. */
+    if( uxIncrements == 0 )
+    {
+        return;
+    }
+
+    pxOld = prvCurrentContext();
+    xInterruptsEnabled = pdFALSE;
+
+    xRefillInTick = pdFALSE;
+#if( configUSE_OVERHEAD_PROFILER == 1 )
+    vOverheadTickStart();
+#endif
+    ullStart = ullPortHostTime();
+
+    while( uxIncrements-- > 0 )
+    {
+        if( xTaskIncrementTick() != pdFALSE )
+        {
+            xSwitchRequired = pdTRUE;
+        }
+    }
+
+    ullTime = ullPortHostTime() - ullStart;
+
+    if( xRefillInTick != pdFALSE )
+    {
+        xCosts.ullRefillTickTime += ullTime;
+        xCosts.ullRefillTicks++;
+
+        if( ullTime > xCosts.ullRefillTickMax )
+        {
+            xCosts.ullRefillTickMax = ullTime;
+        }
+    }
+    else
+    {
+        xCosts.ullTickTime += ullTime;
+        xCosts.ullTicks++;
+
+        if( ullTime > xCosts.ullTickMax )
+        {
+            xCosts.ullTickMax = ullTime;
+        }
+    }
+
+    if( xSwitchRequired != pdFALSE )
+    {
+        prvTimedSwitchContext();
+    }
+
+#if( configUSE_OVERHEAD_PROFILER == 1 )
+    vOverheadTickEnd();
+#endif
+
+    if( xSwitchRequired != pdFALSE )
+    {
+        prvSwitchContext( pxOld );
+    }
+
+    xInterruptsEnabled = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    xInterruptsEnabled = pdFALSE;
+    uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    if( uxCriticalNesting > 0 )
+    {
+        uxCriticalNesting--;
+
+        if( uxCriticalNesting == 0 )
+        {
+            xInterruptsEnabled = pdTRUE;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+    xInterruptsEnabled = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+    xInterruptsEnabled = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetTickLimit( uint64_t ullLimit )
+{
+    ullTickLimit = ullLimit;
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullPortGetTicks( void )
+{
+    return ullTicks;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetKernelCosts( PortKernelCosts_t *pxCosts )
+{
+    *pxCosts = xCosts;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetScheduleHook( PortScheduleHook_t pxHook )
+{
+    pxScheduleHook = pxHook;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetFaultHooks( PortJobFaultHook_t pxJobHook, PortTickFaultHook_t pxTickHook )
+{
+    pxJobFaultHook = pxJobHook;
+    pxTickFaultHook = pxTickHook;
+}
+/*-----------------------------------------------------------*/
+
+TickType_t xPortJobExecutionTicks( void *xTask, TickType_t xDuration )
+{
+    if( pxJobFaultHook != NULL )
+    {
+        return pxJobFaultHook( xTask, xDuration );
+    }
+
+    return xDuration;
+}
+/*-----------------------------------------------------------*/
+
+void vPortScheduleEvent( char cEvent, void *xTask, TickType_t xValue )
+{
+    if( cEvent == 'R' )
+    {
+        xRefillInTick = pdTRUE;
+    }
+
+    if( pxScheduleHook != NULL )
+    {
+        pxScheduleHook( ullTicks, cEvent, xTask, xValue );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Defaults for the application hooks, which the simulation may replace. */
+
+void vApplicationIdleHook( void ) __attribute__((weak));
+
+void vApplicationIdleHook( void )
+{
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationTickHook( void ) __attribute__((weak));
+
+void vApplicationTickHook( void )
+{
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationMallocFailedHook( void ) __attribute__((weak));
+
+void vApplicationMallocFailedHook( void )
+{
+    fprintf( stderr, "malloc failed at tick %llu\n", ( unsigned long long ) ullTicks );
+    abort();
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationStackOverflowHook( TaskHandle_t xTask, char *pcTaskName ) __attribute__((weak));
+
+void vApplicationStackOverflowHook( TaskHandle_t xTask, char *pcTaskName )
+{
+    ( void ) xTask;
+
+    fprintf( stderr, "stack overflow in %s at tick %llu\n", pcTaskName, ( unsigned long long ) ullTicks );
+    abort();
+}
@@ -0,0 +1,231 @@
+/*
+ * FreeRTOS Kernel V10.2.0
+ * Copyright (C) 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------
+ * Port specific definitions for the POSIX host simulator.
+ *
+ * Tasks run as ucontext coroutines of one host thread, so a simulation is
+ * deterministic.  Ticks come from a virtual clock that only advances when
+ * the running task waits for the tick count to change (portSPIN_WAIT()), so
+ * a simulated tick takes as long as the work done in it, not 1/configTICK_RATE_HZ.
+ *-----------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Type definitions. */
+#define portCHAR        char
+#define portFLOAT       float
+#define portDOUBLE      double
+#define portLONG        long
+#define portSHORT       short
+#define portSTACK_TYPE  uintptr_t
+#define portBASE_TYPE   long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if( configUSE_16_BIT_TICKS == 1 )
+    typedef uint16_t TickType_t;
+    #define portMAX_DELAY ( TickType_t ) 0xffff
+#else
+    typedef uint32_t TickType_t;
+    #define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+#endif
+
+/* Only one host thread touches the tick count. */
+#define portTICK_TYPE_IS_ATOMIC         1
+
+/*-----------------------------------------------------------*/
+
+/* Critical section management.  Interrupts are only simulated, so masking
+them just holds off the virtual tick. */
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+extern void vPortDisableInterrupts( void );
+extern void vPortEnableInterrupts( void );
+
+#define portENTER_CRITICAL()            vPortEnterCritical()
+#define portEXIT_CRITICAL()             vPortExitCritical()
+#define portDISABLE_INTERRUPTS()        vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()         vPortEnableInterrupts()
+
+/*-----------------------------------------------------------*/
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH                ( -1 )
+#define portBYTE_ALIGNMENT              8
+#define portNOP()
+
+/* Timing for the scheduler.  The virtual clock has no wall time, so the rate
+only sets how pdMS_TO_TICKS() converts. */
+#define configTICK_RATE_HZ              ( ( TickType_t ) 1000 )
+#define portTICK_PERIOD_MS              ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+
+/*-----------------------------------------------------------*/
+
+/* Program memory is ordinary memory on the host. */
+#define portFLASH
+#define portFLASH_STRING( pcString )                ( pcString )
+#define portFLASH_READ( pvDest, pvSource, uxLength )    memcpy( ( pvDest ), ( pvSource ), ( uxLength ) )
+#define portFLASH_READ_BYTE( pvSource )             ( *( const uint8_t * ) ( pvSource ) )
+
+/*-----------------------------------------------------------*/
+
+/* Non-volatile storage is a RAM array, erased at start up. */
+#define portEEPROM_SIZE                 4096
+
+extern uint8_t ucPortEEPROM[ portEEPROM_SIZE ];
+
+#define portEEPROM_READ( pvDest, uxAddress, uxLength )     memcpy( ( pvDest ), &ucPortEEPROM[ ( uxAddress ) ], ( uxLength ) )
+#define portEEPROM_WRITE( pvSource, uxAddress, uxLength )  memcpy( &ucPortEEPROM[ ( uxAddress ) ], ( pvSource ), ( uxLength ) )
+
+/* End of the program text, set by the linker. */
+extern char etext;
+
+#define portPROGRAM_END_ADDRESS()   ( ( portPOINTER_SIZE_TYPE ) &etext )
+
+/*-----------------------------------------------------------*/
+
+/* Kernel utilities. */
+extern void vPortYield( void );
+#define portYIELD()                     vPortYield()
+
+/* Busy waits on the tick count advance the virtual clock by one tick. */
+extern void vPortSpinWait( void );
+#define portSPIN_WAIT()                 vPortSpinWait()
+
+/* Frees the host context of a deleted task. */
+extern void vPortCleanUpTCB( void *pxTCB );
+#define portCLEAN_UP_TCB( pxTCB )       vPortCleanUpTCB( pxTCB )
+
+/*-----------------------------------------------------------*/
+
+/* Simulation control, for the program driving the simulation. */
+
+/* Ends the scheduler, returning from vTaskStartScheduler(), once the given
+number of ticks have elapsed.  Zero runs forever. */
+void vPortSetTickLimit( uint64_t ullTicks );
+
+/* Ticks elapsed since the scheduler started, without wrapping. */
+uint64_t ullPortGetTicks( void );
+
+/* Receives the schedule as it is made, so a run can be checked against a
+schedule worked out independently.  Events are 'S' when a task is switched
+in, 'E' when it ends a job, 'D' when a periodic job ends after its deadline
+xValue, 'F' when server capacity xValue is scheduled to be given back and 'R'
+when capacity xValue is given back.  xTask is NULL for server events. */
+typedef void ( *PortScheduleHook_t )( uint64_t ullTick, char cEvent, void *xTask, TickType_t xValue );
+
+void vPortSetScheduleHook( PortScheduleHook_t pxHook );
+
+extern void vPortScheduleEvent( char cEvent, void *xTask, TickType_t xValue );
+
+/* Fault injection.  The job hook returns the ticks a job of xTask really runs
+for, given its declared duration, when the job starts.  The tick hook returns
+how many ticks the kernel is given on virtual tick ullTick: 0 loses the tick
+or holds it back, and more than 1 delivers held ticks late, all at once.
+Either hook may be NULL. */
+typedef TickType_t ( *PortJobFaultHook_t )( void *xTask, TickType_t xDuration );
+typedef UBaseType_t ( *PortTickFaultHook_t )( uint64_t ullTick );
+
+void vPortSetFaultHooks( PortJobFaultHook_t pxJobHook, PortTickFaultHook_t pxTickHook );
+
+extern TickType_t xPortJobExecutionTicks( void *xTask, TickType_t xDuration );
+#define portJOB_EXECUTION_TICKS( pxTCB, xDuration )     xPortJobExecutionTicks( ( pxTCB ), ( xDuration ) )
+
+/* Host time spent in the kernel calls the port makes, in nanoseconds, since
+the scheduler started, with the longest single tick.  Ticks that gave back
+server capacity are counted apart from the others. */
+typedef struct PortKernelCosts
+{
+    uint64_t ullSwitches;
+    uint64_t ullSwitchTime;
+    uint64_t ullTicks;
+    uint64_t ullTickTime;
+    uint64_t ullTickMax;
+    uint64_t ullRefillTicks;
+    uint64_t ullRefillTickTime;
+    uint64_t ullRefillTickMax;
+} PortKernelCosts_t;
+
+void vPortGetKernelCosts( PortKernelCosts_t *pxCosts );
+
+/* Host clock used for the costs, in nanoseconds. */
+uint64_t ullPortHostTime( void );
+
+/* Run time statistics count virtual ticks, so a simulated task is charged
+for each tick it was running when the tick occurred. */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()    ( ( uint32_t ) ullPortGetTicks() )
+#define portRUN_TIME_COUNTS_PER_TICK        ( 1UL )
+
+/* The overhead profiler times the host, in nanoseconds. */
+#define portOVERHEAD_TYPE                   uint32_t
+#define portOVERHEAD_COUNTER()              ( ( uint32_t ) ullPortHostTime() )
+#define portOVERHEAD_NS_PER_COUNT           ( 1UL )
+
+#ifndef traceTASK_SWITCHED_IN
+    #define traceTASK_SWITCHED_IN()                         vPortScheduleEvent( 'S', pxCurrentTCB, 0 )
+#endif
+
+#ifndef traceJOB_END
+    #define traceJOB_END( pxTCB )                           vPortScheduleEvent( 'E', ( pxTCB ), 0 )
+#endif
+
+#ifndef traceJOB_DEADLINE_MISS
+    #define traceJOB_DEADLINE_MISS( pxTCB, xDeadline )      vPortScheduleEvent( 'D', ( pxTCB ), ( xDeadline ) )
+#endif
+
+#ifndef traceSERVER_REFILL_SET
+    #define traceSERVER_REFILL_SET( xAmount, xRefillTick )  vPortScheduleEvent( 'F', NULL, ( xAmount ) )
+#endif
+
+#ifndef traceSERVER_REFILL
+    #define traceSERVER_REFILL( xAmount )                   vPortScheduleEvent( 'R', NULL, ( xAmount ) )
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
@@ -0,0 +1,441 @@
+/*
+ * Randomised task set stress test for the POSIX host port.
+ *
+ * For every task count in counts[] and utilisation in utilisations[], draws
+ * task sets with UUniFast utilisations and log-uniform periods, and for each:
+ *
+ *   - submits the periodic tasks with 'B' and 'b' commands and notes whether
+ *     the admission test accepted them,
+ *   - sizes the server with the 'c' command and sets it with 's',
+ *   - adds aperiodic jobs with Poisson arrivals with 'a' commands,
+ *   - simulates the set from its critical instant, counting periodic jobs
+ *     that ended after their deadline and timing every aperiodic job.
+ *
+ * Admission is compared with exact rate monotonic response time analysis:
+ * a false accept is a set the analysis finds unschedulable, a false reject
+ * one it finds schedulable.  A server is unsafe when the analysis passes
+ * without it and fails with it.  One CSV row is printed per task count and
+ * utilisation.  Build it like bench_posix.c, and run it with the number of
+ * sets per row (100 by default) and a random seed (1 by default).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Arduino_FreeRTOS.h"
+#include "task.h"
+
+static const UBaseType_t counts[] = {3, 6, 10};
+static const double utilisations[] = {0.5, 0.6, 0.7, 0.75, 0.8, 0.85, 0.9, 0.95};
+
+#define STRESS_MAX_TASKS 10
+#define STRESS_MIN_PERIOD 10
+#define STRESS_MAX_PERIOD 200
+
+/* Longest run simulated for one set, in ticks. */
+#define STRESS_MAX_RUN 4000
+
+/* Aperiodic arrivals per tick, and the longest aperiodic job. */
+#define STRESS_ARRIVAL_RATE 0.02
+#define STRESS_MAX_APERIODIC_DURATION 3
+#define STRESS_MAX_APERIODIC 200
+
+struct taskSet
+{
+    UBaseType_t count;
+    TickType_t period[STRESS_MAX_TASKS];
+    TickType_t duration[STRESS_MAX_TASKS];
+    UBaseType_t aperiodicCount;
+    TickType_t arrival[STRESS_MAX_APERIODIC];
+    TickType_t aperiodicDuration[STRESS_MAX_APERIODIC];
+    TickType_t run;
+};
+
+/* What the simulation of one set reports back. */
+struct setResult
+{
+    int accepted;
+    TickType_t serverCapacity;
+    TickType_t serverPeriod;
+    unsigned misses;
+    unsigned served;
+    TickType_t response[STRESS_MAX_APERIODIC];
+};
+
+static uint64_t randomState;
+
+static double randomUniform(void)
+{
+    /* xorshift64*, so runs repeat for a seed. */
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+
+    return (double)((randomState * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+/* Draws count utilisations summing to total (Bini and Buttazzo). */
+static void uunifast(UBaseType_t count, double total, double *u)
+{
+    double sum = total, next;
+    UBaseType_t i;
+
+    for (i = 1; i < count; i++)
+    {
+        next = sum * pow(randomUniform(), 1.0 / (double)(count - i));
+        u[i - 1] = sum - next;
+        sum = next;
+    }
+    u[count - 1] = sum;
+}
+
+static TickType_t gcd(TickType_t a, TickType_t b)
+{
+    while (b != 0)
+    {
+        TickType_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+static void drawSet(struct taskSet *set, UBaseType_t count, double utilisation)
+{
+    double u[STRESS_MAX_TASKS];
+    double tick = 0;
+    TickType_t hyperperiod = 1, longest = 0;
+    UBaseType_t i;
+
+    uunifast(count, utilisation, u);
+    set->count = count;
+
+    for (i = 0; i < count; i++)
+    {
+        set->period[i] = (TickType_t)lround(STRESS_MIN_PERIOD * pow((double)STRESS_MAX_PERIOD / STRESS_MIN_PERIOD, randomUniform()));
+        set->duration[i] = (TickType_t)lround(u[i] * set->period[i]);
+
+        if (set->duration[i] == 0)
+        {
+            set->duration[i] = 1;
+        }
+
+        if (hyperperiod <= STRESS_MAX_RUN)
+        {
+            hyperperiod = hyperperiod / gcd(hyperperiod, set->period[i]) * set->period[i];
+        }
+
+        if (set->period[i] > longest)
+        {
+            longest = set->period[i];
+        }
+    }
+
+    set->run = ((hyperperiod < STRESS_MAX_RUN) ? hyperperiod : STRESS_MAX_RUN) + longest;
+
+    /* Poisson arrivals over the run, leaving time for the last to finish. */
+    set->aperiodicCount = 0;
+
+    for (;;)
+    {
+        tick += -log(1.0 - randomUniform()) / STRESS_ARRIVAL_RATE;
+
+        if (tick >= set->run - longest || set->aperiodicCount == STRESS_MAX_APERIODIC)
+        {
+            break;
+        }
+
+        set->arrival[set->aperiodicCount] = (TickType_t)tick;
+        set->aperiodicDuration[set->aperiodicCount] = 1 + (TickType_t)(randomUniform() * STRESS_MAX_APERIODIC_DURATION);
+        set->aperiodicCount++;
+    }
+}
+
+/* Exact rate monotonic test, with the server as a periodic task if its
+period is not zero. */
+static int responseTimeSchedulable(const struct taskSet *set, TickType_t serverCapacity, TickType_t serverPeriod)
+{
+    UBaseType_t i, j;
+
+    for (i = 0; i < set->count; i++)
+    {
+        TickType_t response = set->duration[i], previous = 0;
+
+        while (response != previous && response <= set->period[i])
+        {
+            previous = response;
+            response = set->duration[i];
+
+            for (j = 0; j < set->count; j++)
+            {
+                if (j != i && (set->period[j] < set->period[i] || (set->period[j] == set->period[i] && j < i)))
+                {
+                    response += (previous + set->period[j] - 1) / set->period[j] * set->duration[j];
+                }
+            }
+
+            if (serverPeriod != 0 && serverPeriod < set->period[i])
+            {
+                response += (previous + serverPeriod - 1) / serverPeriod * serverCapacity;
+            }
+        }
+
+        if (response > set->period[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*-----------------------------------------------------------*/
+
+/* State of the simulation, in the child process. */
+static const struct taskSet *running;
+static struct setResult result;
+static unsigned completed[STRESS_MAX_TASKS];
+static int rejected;
+static float suggested;
+
+static void captureString(const char *string)
+{
+    (void)string;
+}
+
+static void captureFlashString(const char *string)
+{
+    if (strstr(string, "Cant") != NULL)
+    {
+        rejected = 1;
+    }
+}
+
+static void captureNumber(int number)
+{
+    (void)number;
+}
+
+static void captureFloat(float number)
+{
+    suggested = number;
+}
+
+static void recordJobEnd(uint64_t tick, char event, void *task, TickType_t value)
+{
+    const char *name;
+    unsigned index;
+
+    (void)value;
+
+    if (event != 'E')
+    {
+        return;
+    }
+
+    name = pcTaskGetName(task);
+    index = (unsigned)atoi(name + 1);
+
+    if (name[0] == 't' && index < running->count)
+    {
+        if (tick > (uint64_t)(completed[index] + 1) * running->period[index])
+        {
+            result.misses++;
+        }
+        completed[index]++;
+    }
+    else if (name[0] == 'a' && index < running->aperiodicCount)
+    {
+        result.response[index] = (TickType_t)(tick - running->arrival[index]);
+        result.served++;
+    }
+}
+
+static void simulateSet(const struct taskSet *set, int output)
+{
+    char line[64];
+    UBaseType_t i;
+
+    running = set;
+    memset(&result, 0, sizeof(result));
+    memset(completed, 0, sizeof(completed));
+
+    set_print_str(captureString);
+    set_print_str_P(captureFlashString);
+    set_print_num(captureNumber);
+    set_print_float(captureFloat);
+
+    for (i = 0; i < set->count; i++)
+    {
+        snprintf(line, sizeof(line), "%c p-t%u-w-x-0-%lu-%lu", (i + 1 < set->count) ? 'B' : 'b', (unsigned)i,
+                 (unsigned long)set->period[i], (unsigned long)set->duration[i]);
+        parseInput(line);
+    }
+    result.accepted = !rejected;
+
+    if (result.accepted)
+    {
+        /* A server at the shortest period serves aperiodic jobs first. */
+        result.serverPeriod = set->period[0];
+
+        for (i = 1; i < set->count; i++)
+        {
+            if (set->period[i] < result.serverPeriod)
+            {
+                result.serverPeriod = set->period[i];
+            }
+        }
+        result.serverPeriod = (result.serverPeriod > 2) ? result.serverPeriod - 1 : 1;
+
+        snprintf(line, sizeof(line), "c %lu", (unsigned long)result.serverPeriod);
+        parseInput(line);
+        result.serverCapacity = (suggested > 0) ? (TickType_t)suggested : 0;
+
+        snprintf(line, sizeof(line), "s %lu %lu", (unsigned long)result.serverCapacity, (unsigned long)result.serverPeriod);
+        parseInput(line);
+
+        for (i = 0; i < set->aperiodicCount; i++)
+        {
+            snprintf(line, sizeof(line), "a a%u w x %lu 0 %lu", (unsigned)i, (unsigned long)set->arrival[i],
+                     (unsigned long)set->aperiodicDuration[i]);
+            parseInput(line);
+        }
+
+        vPortSetScheduleHook(recordJobEnd);
+        vPortSetTickLimit(set->run);
+        vTaskStartScheduler();
+
+        /* Jobs whose deadline passed without them ending. */
+        for (i = 0; i < set->count; i++)
+        {
+            unsigned due = (unsigned)(set->run / set->period[i]);
+
+            if (completed[i] < due)
+            {
+                result.misses += due - completed[i];
+            }
+        }
+    }
+
+    if (write(output, &result, sizeof(result)) != sizeof(result))
+    {
+        _exit(1);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int compareTicks(const void *a, const void *b)
+{
+    TickType_t x = *(const TickType_t *)a, y = *(const TickType_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned sets = (argc > 1) ? (unsigned)atoi(argv[1]) : 100;
+    static struct taskSet set;
+    static struct setResult outcome;
+    TickType_t *responses = malloc((size_t)sets * STRESS_MAX_APERIODIC * sizeof(TickType_t));
+    size_t c, u;
+
+    randomState = (argc > 2) ? strtoull(argv[2], NULL, 10) : 1;
+    randomState = (randomState == 0) ? 1 : randomState;
+
+    printf("tasks,utilisation,sets,accepted,false_accepts,false_rejects,sets_missing_deadlines,"
+           "unsafe_servers,aperiodic_jobs,unserved_jobs,response_p50,response_p95,response_max\n");
+    fflush(stdout);
+
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        for (u = 0; u < sizeof(utilisations) / sizeof(utilisations[0]); u++)
+        {
+            unsigned accepted = 0, falseAccepts = 0, falseRejects = 0, missing = 0, unsafe = 0;
+            unsigned jobs = 0, unserved = 0, s, i;
+            size_t count = 0;
+
+            for (s = 0; s < sets; s++)
+            {
+                int channel[2];
+                pid_t child;
+                int schedulable;
+
+                drawSet(&set, counts[c], utilisations[u]);
+                schedulable = responseTimeSchedulable(&set, 0, 0);
+
+                if (pipe(channel) != 0)
+                {
+                    return 1;
+                }
+
+                child = fork();
+
+                if (child == 0)
+                {
+                    close(channel[0]);
+                    simulateSet(&set, channel[1]);
+                    _exit(0);
+                }
+
+                close(channel[1]);
+
+                if (read(channel[0], &outcome, sizeof(outcome)) != sizeof(outcome))
+                {
+                    outcome.accepted = -1;
+                }
+                close(channel[0]);
+                waitpid(child, NULL, 0);
+
+                if (outcome.accepted < 0)
+                {
+                    fprintf(stderr, "set %u of %lu tasks at %.2f did not finish\n", s, (unsigned long)counts[c], utilisations[u]);
+                    continue;
+                }
+
+                falseAccepts += (outcome.accepted && !schedulable);
+                falseRejects += (!outcome.accepted && schedulable);
+
+                if (!outcome.accepted)
+                {
+                    continue;
+                }
+
+                accepted++;
+                missing += (outcome.misses > 0);
+                unsafe += (schedulable && !responseTimeSchedulable(&set, outcome.serverCapacity, outcome.serverPeriod));
+                jobs += set.aperiodicCount;
+
+                for (i = 0; i < set.aperiodicCount; i++)
+                {
+                    if (outcome.response[i] == 0)
+                    {
+                        unserved++;
+                    }
+                    else
+                    {
+                        responses[count++] = outcome.response[i];
+                    }
+                }
+            }
+
+            qsort(responses, count, sizeof(TickType_t), compareTicks);
+
+            printf("%lu,%.2f,%u,%u,%u,%u,%u,%u,%u,%u,%lu,%lu,%lu\n", (unsigned long)counts[c], utilisations[u], sets,
+                   accepted, falseAccepts, falseRejects, missing, unsafe, jobs, unserved,
+                   (unsigned long)((count > 0) ? responses[count / 2] : 0),
+                   (unsigned long)((count > 0) ? responses[count * 95 / 100] : 0),
+                   (unsigned long)((count > 0) ? responses[count - 1] : 0));
+            fflush(stdout);
+        }
+    }
+
+    free(responses);
+
+    return 0;
+}
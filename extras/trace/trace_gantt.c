@@ -0,0 +1,265 @@
+/*
+ * Decoder for the kernel trace recorder (configUSE_TRACE_RECORDER).
+ *
+ * Reads serial output captured while the host sent framed 'g' commands, from
+ * a board or a host simulation, picks out the 'G' frames and prints a Gantt
+ * chart with one row per task ID and one column per tick:
+ *
+ *   #  the task ran during the tick
+ *   ^  a job of the task was released, seen when it started
+ *   !  a job of the task finished after its deadline
+ *
+ * and a server row marking replenishments with R and exhaustion with X.
+ * Frames with a bad CRC are skipped.  Ticks from a 16 bit kernel are unwrapped.
+ * Build it with any host C compiler, and run it with the capture on stdin and
+ * optionally the first and last tick to draw.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAME_SYNC 0x7E
+
+/* Rows are indexed by task ID.  Records with no task, ID 0xFF, go on their
+own row, and the server follows. */
+#define GANTT_NO_TASK 0xFF
+#define GANTT_SERVER (GANTT_NO_TASK + 1)
+#define GANTT_MAX_TICKS 200
+
+static uint64_t first = 0;
+static uint64_t last = UINT64_MAX;
+
+static char rows[GANTT_SERVER + 1][GANTT_MAX_TICKS];
+static int used[GANTT_SERVER + 1];
+
+/* Task running at the last record, and the tick it was marked up to. */
+static int running = -1;
+static uint64_t markedTo = 0;
+
+static uint64_t base = 0;
+static uint32_t previous = 0;
+static unsigned long dropped = 0;
+static uint64_t lastTick = 0;
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t length)
+{
+    uint8_t i;
+
+    while (length-- > 0)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static const uint8_t *getVarint(const uint8_t *in, const uint8_t *end, uint32_t *value)
+{
+    uint8_t shift = 0;
+
+    *value = 0;
+
+    while (in < end)
+    {
+        *value |= (uint32_t)(*in & 0x7F) << shift;
+
+        if ((*in++ & 0x80) == 0)
+        {
+            return in;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+static void mark(int row, uint64_t tick, char symbol)
+{
+    if (tick < first || tick > last || tick - first >= GANTT_MAX_TICKS)
+    {
+        return;
+    }
+
+    /* Events outrank plain execution. */
+    if (symbol != '#' || rows[row][tick - first] == 0)
+    {
+        rows[row][tick - first] = symbol;
+    }
+    used[row] = 1;
+}
+
+/* Marks the running task in every tick up to and including tick. */
+static void markRunning(uint64_t tick)
+{
+    for (; running >= 0 && markedTo <= tick; markedTo++)
+    {
+        mark(running, markedTo, '#');
+    }
+    markedTo = tick;
+}
+
+static void record(uint8_t event, uint8_t id, uint32_t rawTick, uint32_t value)
+{
+    uint64_t tick;
+
+    if (rawTick < previous)
+    {
+        base += (previous <= 0xFFFF) ? 0x10000ULL : 0x100000000ULL;
+    }
+    previous = rawTick;
+    tick = base + rawTick;
+    lastTick = tick;
+
+    markRunning(tick);
+
+    switch (event)
+    {
+    case 'S':
+        running = id;
+        markedTo = tick;
+        markRunning(tick);
+        break;
+
+    case 'J':
+        /* The release is less than a period back, so within 16 bits. */
+        value = rawTick - value;
+        mark(id, tick - ((value > 0xFFFF) ? (value & 0xFFFF) : value), '^');
+        break;
+
+    case 'D':
+        mark(id, tick, '!');
+        break;
+
+    case 'R':
+        mark(GANTT_SERVER, tick, 'R');
+        break;
+
+    case 'X':
+        mark(GANTT_SERVER, tick, 'X');
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void frame(const uint8_t *payload, uint8_t length)
+{
+    const uint8_t *in = payload;
+    const uint8_t *end = payload + length;
+    uint32_t tick, value;
+
+    in = getVarint(in, end, &value);
+    if (in == NULL)
+    {
+        return;
+    }
+    dropped += value;
+
+    while (in != NULL && in + 2 <= end)
+    {
+        uint8_t event = in[0];
+        uint8_t id = in[1];
+
+        in = getVarint(in + 2, end, &tick);
+        if (in == NULL)
+        {
+            return;
+        }
+        in = getVarint(in, end, &value);
+        if (in == NULL)
+        {
+            return;
+        }
+        record(event, id, tick, value);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t buffer[3 + 255 + 2];
+    uint64_t tick, end;
+    int c, row;
+
+    if (argc > 1)
+    {
+        first = strtoull(argv[1], NULL, 0);
+    }
+    if (argc > 2)
+    {
+        last = strtoull(argv[2], NULL, 0);
+    }
+
+    while ((c = getchar()) != EOF)
+    {
+        uint8_t length;
+        uint16_t crc;
+
+        if (c != FRAME_SYNC || (c = getchar()) == EOF || c == 0)
+        {
+            continue;
+        }
+        length = (uint8_t)c;
+        buffer[0] = length;
+
+        if (fread(&buffer[1], 1, length + 2, stdin) != (size_t)length + 2)
+        {
+            break;
+        }
+
+        crc = crc16(0xFFFF, buffer, length + 1);
+        if (buffer[1] != 'G' || buffer[length + 1] != (uint8_t)crc || buffer[length + 2] != (uint8_t)(crc >> 8))
+        {
+            continue;
+        }
+
+        frame(&buffer[2], length - 1);
+    }
+
+    markRunning(lastTick);
+
+    end = (last < lastTick) ? last : lastTick;
+    if (end - first >= GANTT_MAX_TICKS)
+    {
+        end = first + GANTT_MAX_TICKS - 1;
+    }
+
+    printf("ticks %llu to %llu, %lu records dropped\n", (unsigned long long)first, (unsigned long long)end, dropped);
+
+    for (row = 0; row <= GANTT_SERVER; row++)
+    {
+        if (used[row] == 0)
+        {
+            continue;
+        }
+
+        if (row == GANTT_SERVER)
+        {
+            printf("server ");
+        }
+        else if (row == GANTT_NO_TASK)
+        {
+            printf("  none ");
+        }
+        else
+        {
+            printf("  #%-3d ", row);
+        }
+
+        for (tick = first; tick <= end; tick++)
+        {
+            char symbol = rows[row][tick - first];
+
+            putchar(symbol != 0 ? symbol : '.');
+        }
+        putchar('\n');
+    }
+
+    return 0;
+}
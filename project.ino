@@ -1,10 +1,15 @@
 #include <Arduino_FreeRTOS.h>
 
-void print_string_serial(char *string){
+void print_string_serial(const char *string){
   Serial.print(string);
   Serial.flush();
 }
 
+void print_string_P_serial(const char *string){
+  Serial.print((const __FlashStringHelper *)string);
+  Serial.flush();
+}
+
 void print_number_serial(int number){
   Serial.print(number);
   Serial.flush();
@@ -15,33 +20,37 @@ void print_float_serial(float number){
   Serial.flush();
 }
 
+void print_bytes_serial(const uint8_t *bytes, uint8_t length){
+  Serial.write(bytes, length);
+  Serial.flush();
+}
+
 void setup() {
   Serial.begin(9600);
-  Serial.println("Begin");
+  Serial.println(F("Begin"));
   Serial.flush();
   set_print_str(&print_string_serial);
+  set_print_str_P(&print_string_P_serial);
   set_print_num(&print_number_serial);
   set_print_float(&print_float_serial);
-  xTaskCreatePeriodic(reader, "", 120, "", 2, NULL, 0, 0, 0);
+#if (configUSE_FRAMED_COMMANDS == 1)
+  set_print_bytes(&print_bytes_serial);
+#endif
+  xCommandIntakeStart();
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+  restoreTaskSet();
+#endif
 
 }
 
+// The Arduino core owns the USART receive interrupt, so received bytes are
+// moved into the command stream from the tick interrupt instead.
+void vApplicationTickHook(){
+  BaseType_t woken = pdFALSE;
 
-void reader(){
-char input[80];
-  
-  int i;
-  while(1){
-    if(Serial.available()){
-      i = 0;
-      while(Serial.available()){
-        input[i++] = Serial.read();
-      }
-      input[i] = 0;    
-      parseInput(input);
-    }
-    vTaskDelay(10);
+  while(Serial.available()){
+    commandReceiveFromISR(Serial.read(), &woken);
   }
 }
 
-void loop() {}
\ No newline at end of file
+void loop() {}
@@ -59,6 +59,22 @@ extern "C" {
 #include "projdefs.h"
 
 /* Definitions specific to the port being used. */
+/* The trace recorder takes the kernel trace macros ahead of any hooks of
+the port. */
+#if ( configUSE_TRACE_RECORDER == 1 )
+    #define traceTASK_SWITCHED_IN()                     vTraceRecord( 'S', NULL, 0 )
+    #define traceTASK_SWITCHED_OUT()                    vTraceRecord( 'O', NULL, 0 )
+    #define traceMOVED_TASK_TO_READY_STATE( pxTCB )     vTraceRecord( 'U', ( pxTCB ), 0 )
+    #define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )   vTraceRecord( 'B', NULL, 0 )
+    #define traceBLOCKING_ON_QUEUE_PEEK( pxQueue )      vTraceRecord( 'B', NULL, 0 )
+    #define traceBLOCKING_ON_QUEUE_SEND( pxQueue )      vTraceRecord( 'B', NULL, 0 )
+    #define traceJOB_START( pxTCB, xRelease )           vTraceRecord( 'J', ( pxTCB ), ( xRelease ) )
+    #define traceJOB_END( pxTCB )                       vTraceRecord( 'E', ( pxTCB ), 0 )
+    #define traceJOB_DEADLINE_MISS( pxTCB, xDeadline )  vTraceRecord( 'D', ( pxTCB ), ( xDeadline ) )
+    #define traceSERVER_REFILL( xAmount )               vTraceRecord( 'R', NULL, ( xAmount ) )
+    #define traceSERVER_EXHAUSTED()                     vTraceRecord( 'X', NULL, 0 )
+#endif
+
 #include "portable.h"
 
 /* Must be defaulted before configUSE_NEWLIB_REENTRANT is used below. */
@@ -274,6 +290,18 @@ extern "C" {
     #define portSETUP_TCB( pxTCB ) ( void ) pxTCB
 #endif
 
+#ifndef portSPIN_WAIT
+    /* Called by loops that wait for the tick count to change.  A simulator
+    port advances its clock here. */
+    #define portSPIN_WAIT()
+#endif
+
+#ifndef portJOB_EXECUTION_TICKS
+    /* Ticks a job runs for, given its declared duration.  A simulator port
+    can lengthen or shorten jobs here to inject faults. */
+    #define portJOB_EXECUTION_TICKS( pxTCB, xDuration ) ( xDuration )
+#endif
+
 #ifndef configQUEUE_REGISTRY_SIZE
     #define configQUEUE_REGISTRY_SIZE 0U
 #endif
@@ -524,6 +552,39 @@ extern "C" {
     #define traceTASK_INCREMENT_TICK( xTickCount )
 #endif
 
+#ifndef traceJOB_START
+    /* Called when the running task starts its first tick of a job released
+    at xRelease. */
+    #define traceJOB_START( pxTCB, xRelease )
+#endif
+
+#ifndef traceJOB_END
+    /* Called when the running task finishes a periodic or aperiodic job. */
+    #define traceJOB_END( pxTCB )
+#endif
+
+#ifndef traceJOB_DEADLINE_MISS
+    /* Called when a periodic job finishes after xDeadline, the release of the
+    next job. */
+    #define traceJOB_DEADLINE_MISS( pxTCB, xDeadline )
+#endif
+
+#ifndef traceSERVER_REFILL_SET
+    /* Called when server capacity used by an aperiodic job is scheduled to
+    be given back at xRefillTick. */
+    #define traceSERVER_REFILL_SET( xAmount, xRefillTick )
+#endif
+
+#ifndef traceSERVER_REFILL
+    /* Called from the tick interrupt as server capacity is given back. */
+    #define traceSERVER_REFILL( xAmount )
+#endif
+
+#ifndef traceSERVER_EXHAUSTED
+    /* Called when an aperiodic job uses the last of the server capacity. */
+    #define traceSERVER_EXHAUSTED()
+#endif
+
 #ifndef traceTIMER_CREATE
     #define traceTIMER_CREATE( pxNewTimer )
 #endif
@@ -704,6 +765,10 @@ extern "C" {
         #endif /* portALT_GET_RUN_TIME_COUNTER_VALUE */
     #endif /* portGET_RUN_TIME_COUNTER_VALUE */
 
+    #ifndef portRUN_TIME_COUNTS_PER_TICK
+        #error If configGENERATE_RUN_TIME_STATS is defined then portRUN_TIME_COUNTS_PER_TICK must also be defined as the nominal number of run time counter units in one tick.
+    #endif /* portRUN_TIME_COUNTS_PER_TICK */
+
 #endif /* configGENERATE_RUN_TIME_STATS */
 
 #ifndef portCONFIGURE_TIMER_FOR_RUN_TIME_STATS
@@ -841,6 +906,208 @@ extern "C" {
     #define configMESSAGE_BUFFER_LENGTH_TYPE size_t
 #endif
 
+#ifndef configCOMMAND_STREAM_SIZE
+    /* Bytes of received serial input buffered for the command task. */
+    #define configCOMMAND_STREAM_SIZE configCOMMAND_LINE_LENGTH
+#endif
+
+#ifndef configCOMMAND_LINE_LENGTH
+    /* Longest command line, including the terminator.  Longer lines are
+    discarded. */
+    #define configCOMMAND_LINE_LENGTH 80
+#endif
+
+#ifndef configCOMMAND_TASK_STACK_SIZE
+    #define configCOMMAND_TASK_STACK_SIZE 120
+#endif
+
+#ifndef configTASK_REGISTRY_SIZE
+    /* Tasks that commands can address by ID or name. */
+    #define configTASK_REGISTRY_SIZE 16
+#endif
+
+#if( ( configTASK_REGISTRY_SIZE < 1 ) || ( configTASK_REGISTRY_SIZE > 255 ) )
+    #error configTASK_REGISTRY_SIZE must be between 1 and 255
+#endif
+
+#ifndef configJOB_SCRATCH_SIZE
+    /* RAM touched by the memory job kernel, in bytes. */
+    #define configJOB_SCRATCH_SIZE 32
+#endif
+
+#if( configJOB_SCRATCH_SIZE < 1 )
+    #error configJOB_SCRATCH_SIZE must be at least 1
+#endif
+
+#ifndef configUSE_SHARED_JOB_STACK
+    #define configUSE_SHARED_JOB_STACK 0
+#endif
+
+#ifndef configSHARED_JOB_STACK_SIZE
+    /* Depth of the stack shared by all periodic jobs, in words. */
+    #define configSHARED_JOB_STACK_SIZE 256
+#endif
+
+#ifndef configSHARED_JOB_STACK_MARGIN
+    /* Words left free below a preempted job before the next job's frame is
+    placed, as the scheduler itself runs on the stack of the preempted job. */
+    #define configSHARED_JOB_STACK_MARGIN 48
+#endif
+
+#ifndef configUSE_STACK_PROFILING
+    #define configUSE_STACK_PROFILING 0
+#endif
+
+#ifndef configUSE_STACK_PROFILE_SIZES
+    #define configUSE_STACK_PROFILE_SIZES 0
+#endif
+
+#ifndef configSTACK_PROFILE_ENTRIES
+    /* Number of distinct job functions whose stack use is recorded. */
+    #define configSTACK_PROFILE_ENTRIES 6
+#endif
+
+#ifndef configSTACK_PROFILE_MARGIN
+    /* Words added to the measured stack use when recommending a size. */
+    #define configSTACK_PROFILE_MARGIN 16
+#endif
+
+#ifndef configSTACK_PROFILE_EEPROM_ADDRESS
+    #define configSTACK_PROFILE_EEPROM_ADDRESS 0
+#endif
+
+#if( ( configUSE_STACK_PROFILING == 1 ) && ( INCLUDE_uxTaskGetStackHighWaterMark != 1 ) )
+    #error INCLUDE_uxTaskGetStackHighWaterMark must be set to 1 to use configUSE_STACK_PROFILING
+#endif
+
+#if( ( ( configUSE_STACK_PROFILING == 1 ) || ( configUSE_STACK_PROFILE_SIZES == 1 ) ) && !defined( portPROGRAM_END_ADDRESS ) )
+    #error Stack profiles need portPROGRAM_END_ADDRESS from the port to tell one build from another.
+#endif
+
+#ifndef configUSE_TASK_SET_SNAPSHOT
+    #define configUSE_TASK_SET_SNAPSHOT 0
+#endif
+
+#ifndef configTASK_SET_SNAPSHOT_ENTRIES
+    /* Largest number of periodic tasks kept in the snapshot. */
+    #define configTASK_SET_SNAPSHOT_ENTRIES 8
+#endif
+
+#ifndef configTASK_SET_EEPROM_ADDRESS
+    #define configTASK_SET_EEPROM_ADDRESS 64
+#endif
+
+#ifndef configUSE_TASK_RECYCLING
+    #define configUSE_TASK_RECYCLING 0
+#endif
+
+#ifndef configTASK_RECYCLE_CACHE_SIZE
+    /* Largest number of deleted TCB/stack pairs kept for reuse. */
+    #define configTASK_RECYCLE_CACHE_SIZE 4
+#endif
+
+#ifndef configTASK_RECLAIM_BATCH
+    /* Deleted tasks reclaimed per pass of the idle task. */
+    #define configTASK_RECLAIM_BATCH 2
+#endif
+
+#if( ( configUSE_TASK_RECYCLING == 1 ) && ( INCLUDE_vTaskDelete != 1 ) )
+    #error INCLUDE_vTaskDelete must be set to 1 to use configUSE_TASK_RECYCLING
+#endif
+
+#ifndef configUSE_FRAMED_COMMANDS
+    #define configUSE_FRAMED_COMMANDS 0
+#endif
+
+#ifndef configFRAME_OUTPUT_SIZE
+    /* Bytes of outgoing frames queued for the idle task to write out. */
+    #define configFRAME_OUTPUT_SIZE 32
+#endif
+
+#ifndef configSTATE_SNAPSHOT_LENGTH
+    /* Largest state snapshot frame payload, built in a static buffer. */
+    #define configSTATE_SNAPSHOT_LENGTH 128
+#endif
+
+#ifndef configUSE_TRACE_BUFFER
+    #define configUSE_TRACE_BUFFER 0
+#endif
+
+#ifndef configTRACE_BUFFER_SIZE
+    /* Job output events held until the idle task prints them. */
+    #define configTRACE_BUFFER_SIZE 16
+#endif
+
+#ifndef configTRACE_TEXT_LENGTH
+    /* Bytes of job output text kept in each event, including the terminator. */
+    #define configTRACE_TEXT_LENGTH 8
+#endif
+
+#ifndef configUSE_MODE_CHANGE
+    #define configUSE_MODE_CHANGE 0
+#endif
+
+#ifndef configUSE_TASK_RETIMING
+    #define configUSE_TASK_RETIMING 0
+#endif
+
+#ifndef configUSE_AUTO_PHASE
+    #define configUSE_AUTO_PHASE 0
+#endif
+
+#ifndef configAUTO_PHASE_HORIZON
+    /* Longest stretch of releases compared when choosing a phase, in ticks. */
+    #define configAUTO_PHASE_HORIZON 500
+#endif
+
+#if( configAUTO_PHASE_HORIZON < 1 )
+    #error configAUTO_PHASE_HORIZON must be at least 1
+#endif
+
+#ifndef configUSE_APERIODIC_STATS
+    #define configUSE_APERIODIC_STATS 0
+#endif
+
+#ifndef configUSE_TRACE_RECORDER
+    #define configUSE_TRACE_RECORDER 0
+#endif
+
+#ifndef configTRACE_RECORDER_SIZE
+    #define configTRACE_RECORDER_SIZE 32
+#endif
+
+#ifndef configUSE_OVERHEAD_PROFILER
+    #define configUSE_OVERHEAD_PROFILER 0
+#endif
+
+#ifndef configOVERHEAD_SITES
+    #define configOVERHEAD_SITES 16
+#endif
+
+#if( ( configUSE_OVERHEAD_PROFILER == 1 ) && !defined( portOVERHEAD_COUNTER ) )
+    #error configUSE_OVERHEAD_PROFILER needs portOVERHEAD_COUNTER from the port.  The AVR port provides it with configGENERATE_RUN_TIME_STATS.
+#endif
+
+#if( ( configUSE_TRACE_RECORDER == 1 ) && ( ( configTRACE_RECORDER_SIZE & ( configTRACE_RECORDER_SIZE - 1 ) ) != 0 || configTRACE_RECORDER_SIZE > 128 ) )
+    #error configTRACE_RECORDER_SIZE must be a power of two no larger than 128
+#endif
+
+#if( ( configUSE_TRACE_BUFFER == 1 ) && ( ( configTRACE_BUFFER_SIZE & ( configTRACE_BUFFER_SIZE - 1 ) ) != 0 || configTRACE_BUFFER_SIZE > 128 ) )
+    #error configTRACE_BUFFER_SIZE must be a power of two no larger than 128
+#endif
+
+#if( ( configUSE_TRACE_BUFFER == 1 ) && ( configTRACE_TEXT_LENGTH < 1 || configTRACE_TEXT_LENGTH > 64 ) )
+    #error configTRACE_TEXT_LENGTH must be from 1 to 64
+#endif
+
+#if( ( configUSE_FRAMED_COMMANDS == 1 ) && ( configSTATE_SNAPSHOT_LENGTH < 32 || configSTATE_SNAPSHOT_LENGTH > 254 ) )
+    #error configSTATE_SNAPSHOT_LENGTH must be from 32 to 254
+#endif
+
+#if( configCOMMAND_STREAM_SIZE < configCOMMAND_LINE_LENGTH )
+    #error configCOMMAND_STREAM_SIZE must hold a whole line of configCOMMAND_LINE_LENGTH
+#endif
+
 /* Sanity check the configuration. */
 #if( configUSE_TICKLESS_IDLE != 0 )
     #if( INCLUDE_vTaskSuspend != 1 )
@@ -1267,7 +1534,9 @@ typedef StaticStreamBuffer_t StaticMessageBuffer_t;
 #endif
 
 /* Variant (AVR) specific configuration options. */
-#include "FreeRTOSVariant.h"
+#if defined( __AVR__ )
+    #include "FreeRTOSVariant.h"
+#endif
 
 #endif /* INC_ARDUINO_FREERTOS_H */
 
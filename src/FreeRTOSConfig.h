@@ -28,7 +28,9 @@
 #ifndef FREERTOS_CONFIG_H
 #define FREERTOS_CONFIG_H
 
+#if defined( __AVR__ )
 #include <avr/io.h>
+#endif
 
 /*-----------------------------------------------------------
  * Application specific definitions.
@@ -45,13 +47,17 @@
 // And on to the things the same no matter the AVR type...
 #define configUSE_PREEMPTION                1
 #define configUSE_IDLE_HOOK                 1
-#define configUSE_TICK_HOOK                 0
+#define configUSE_TICK_HOOK                 1
 #define configCPU_CLOCK_HZ                  ( ( uint32_t ) F_CPU )          // This F_CPU variable set by the environment
 #define configMAX_PRIORITIES                4
 #define configMINIMAL_STACK_SIZE            ( 192 )
 #define configMAX_TASK_NAME_LEN             ( 8 )
 #define configUSE_TRACE_FACILITY            0
+#if defined( __AVR__ )
 #define configUSE_16_BIT_TICKS              1
+#else
+#define configUSE_16_BIT_TICKS              0   // Simulations run for millions of ticks.
+#endif
 #define configIDLE_SHOULD_YIELD             1
 
 #define configUSE_MUTEXES                   1
@@ -80,7 +86,11 @@
 #define configSTACK_DEPTH_TYPE              uint16_t
 
 /* Set the stack pointer type to be uint16_t, otherwise it defaults to unsigned long */
+#if defined( __AVR__ )
 #define portPOINTER_SIZE_TYPE               uint16_t
+#else
+#define portPOINTER_SIZE_TYPE               uintptr_t
+#endif
 
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
@@ -101,6 +111,105 @@ to exclude the API function. */
 #define configMAX(a,b)  ({ __typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a > _b ? _a : _b; })
 #define configMIN(a,b)  ({ __typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a < _b ? _a : _b; })
 
+#if defined( __AVR__ )
 #define configTOTAL_HEAP_SIZE      1320
+#else
+#define configTOTAL_HEAP_SIZE      ( 16 * 1024 * 1024 )
+#endif
+
+/* Sporadic server kernel options. */
+
+/* Serial commands are fed to a stream buffer from the tick hook, and parsed
+by a task that only wakes once a complete line has arrived.  The stream holds
+at least one whole line. */
+#define configCOMMAND_STREAM_SIZE           ( 80 )
+#define configCOMMAND_LINE_LENGTH           ( 80 )
+#define configCOMMAND_TASK_STACK_SIZE       ( 120 )
+
+/* Largest number of tasks that commands can address by ID or name. */
+#define configTASK_REGISTRY_SIZE            ( 16 )
+
+/* Bytes of RAM the memory touch job kernel ('m') walks through each tick. */
+#define configJOB_SCRATCH_SIZE              ( 32 )
+
+/* Run periodic jobs on one shared stack under the Stack Resource Policy,
+instead of giving every periodic task its own stack. */
+#define configUSE_SHARED_JOB_STACK          0
+#define configSHARED_JOB_STACK_SIZE         ( 256 )
+#define configSHARED_JOB_STACK_MARGIN       ( 48 )
+
+/* Record the stack each job function uses, and optionally create tasks with
+the sizes learned on an earlier run and saved to EEPROM. */
+#define configUSE_STACK_PROFILING           0
+#define configUSE_STACK_PROFILE_SIZES       0
+#define configSTACK_PROFILE_ENTRIES         ( 6 )
+#define configSTACK_PROFILE_MARGIN          ( 16 )
+#define configSTACK_PROFILE_EEPROM_ADDRESS  ( 0 )
+
+/* Keep the admitted task set and server configuration in EEPROM, and
+restore it from setup() after a reset. */
+#define configUSE_TASK_SET_SNAPSHOT         0
+#define configTASK_SET_SNAPSHOT_ENTRIES     ( 8 )
+#define configTASK_SET_EEPROM_ADDRESS       ( 64 )
+
+/* Keep deleted TCB/stack pairs for reuse by xTaskCreatePeriodic(), and
+reclaim deleted tasks in bounded batches from the idle task. */
+#define configUSE_TASK_RECYCLING            0
+#define configTASK_RECYCLE_CACHE_SIZE       ( 4 )
+#define configTASK_RECLAIM_BATCH            ( 2 )
+
+/* Accept CRC checked binary command frames once the GUI has asked for them
+with the 'f' command.  Frames longer than configCOMMAND_LINE_LENGTH are
+rejected.  Frames are written out by the idle task alone; other tasks queue
+theirs in a stream of configFRAME_OUTPUT_SIZE bytes. */
+#define configUSE_FRAMED_COMMANDS           1
+#define configFRAME_OUTPUT_SIZE             ( 32 )
+
+/* Bytes set aside for the state snapshot sent in reply to a framed 'q'.
+Tasks that do not fit are left out of it. */
+#define configSTATE_SNAPSHOT_LENGTH         ( 128 )
+
+/* Queue job output as binary events that the idle task prints, instead of
+printing from inside the job.  The buffer size must be a power of two.  Each
+event keeps up to configTRACE_TEXT_LENGTH - 1 characters of the job's text. */
+#define configUSE_TRACE_BUFFER              0
+#define configTRACE_BUFFER_SIZE             ( 16 )
+#define configTRACE_TEXT_LENGTH             ( 8 )
+
+/* Allow a whole task set and server to be staged and switched to at an
+idle instant or hyperperiod boundary. */
+#define configUSE_MODE_CHANGE               0
+
+/* Allow the period, execution time and phase of a periodic task to be
+changed while it runs, from the end of its current job. */
+#define configUSE_TASK_RETIMING             0
+
+/* Let a periodic task created with an arrival of '*' have its phase chosen
+to spread releases over the hyperperiod, searched up to the horizon. */
+#define configUSE_AUTO_PHASE                0
+#define configAUTO_PHASE_HORIZON            ( 500 )
+
+/* Keep histograms of how long aperiodic jobs wait for and take to complete
+under the current server, reported by the 'l' command. */
+#define configUSE_APERIODIC_STATS           0
+
+/* Count the time each task, the server and the idle loop() spend running,
+reported by the 'u' command.  On AVR this takes over Timer1, so it cannot be
+used with the Servo library or analogWrite() on the Timer1 pins. */
+#define configGENERATE_RUN_TIME_STATS       0
+
+/* Record context switches, job releases and ends, deadline misses and server
+events as binary records in RAM, drained by the 'g' command.  The ring size
+must be a power of two. */
+#define configUSE_TRACE_RECORDER            0
+#define configTRACE_RECORDER_SIZE           ( 32 )
+
+/* Time critical sections, scheduler suspensions and the tick interrupt, and
+keep the longest of each call site, reported by the 'o' command.  Call sites
+are lines of tasks.c (T), queue.c (Q), timers.c (I), event_groups.c (E),
+stream_buffer.c (S) or heap_4.c (H).  On AVR this needs
+configGENERATE_RUN_TIME_STATS for Timer1. */
+#define configUSE_OVERHEAD_PROFILER         0
+#define configOVERHEAD_SITES                ( 16 )
 
 #endif /* FREERTOS_CONFIG_H */
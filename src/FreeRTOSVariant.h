@@ -60,6 +60,8 @@ void initVariant(void);
 
 void vApplicationIdleHook( void );
 
+void vApplicationTickHook( void );
+
 void vApplicationMallocFailedHook( void );
 void vApplicationStackOverflowHook( TaskHandle_t xTask, portCHAR *pcTaskName );
 
@@ -481,11 +481,19 @@ void vPortYieldFromTick( void )
 
     sleep_reset();        //     reset the sleep_mode() faster than sleep_disable();
 
+#if ( configUSE_OVERHEAD_PROFILER == 1 )
+    vOverheadTickStart();
+#endif
+
     if( xTaskIncrementTick() != pdFALSE )
     {
         vTaskSwitchContext();
     }
 
+#if ( configUSE_OVERHEAD_PROFILER == 1 )
+    vOverheadTickEnd();
+#endif
+
     portRESTORE_CONTEXT();
 
     __asm__ __volatile__ ( "ret" );
@@ -534,7 +542,54 @@ void prvSetupTimerInterrupt( void )
 //  ISR(portSCHEDULER_ISR, ISR_NOBLOCK) __attribute__ ((hot, flatten));
     ISR(portSCHEDULER_ISR)
     {
+#if ( configUSE_OVERHEAD_PROFILER == 1 )
+        vOverheadTickStart();
+#endif
         xTaskIncrementTick();
+#if ( configUSE_OVERHEAD_PROFILER == 1 )
+        vOverheadTickEnd();
+#endif
     }
 
 #endif // configUSE_PREEMPTION
+
+/*-----------------------------------------------------------*/
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+static volatile uint16_t usRunTimeOverflows = 0;
+
+void vPortSetupRunTimeCounter( void )
+{
+    //run Timer1 free at F_CPU / 64, interrupting on overflow.
+    TCCR1A = 0;
+    TCCR1B = _BV( CS11 ) | _BV( CS10 );
+    TCNT1 = 0;
+    TIFR1 = _BV( TOV1 );
+    TIMSK1 = _BV( TOIE1 );
+}
+
+uint32_t ulPortGetRunTimeCounter( void )
+{
+    uint16_t usHigh, usLow;
+
+    portENTER_CRITICAL();
+    usLow = TCNT1;
+    usHigh = usRunTimeOverflows;
+
+    //count an overflow that is still pending, if it happened before TCNT1 was read.
+    if( ( TIFR1 & _BV( TOV1 ) ) && ( usLow < 0x8000 ) )
+    {
+        usHigh++;
+    }
+    portEXIT_CRITICAL();
+
+    return ( ( uint32_t ) usHigh << 16 ) | usLow;
+}
+
+ISR(TIMER1_OVF_vect)
+{
+    usRunTimeOverflows++;
+}
+
+#endif // configGENERATE_RUN_TIME_STATS
@@ -49,7 +49,12 @@ did not result in a portmacro.h header file being included - and it should be
 included here.  In this case the path to the correct portmacro.h header file
 must be set in the compiler's include path. */
 #ifndef portENTER_CRITICAL
-#include "portmacro.h"
+    #if defined( __AVR__ )
+        #include "portmacro.h"
+    #else
+        /* Host builds use the simulator port in extras/posix. */
+        #include "portmacro_posix.h"
+    #endif
 #endif
 
 #if portBYTE_ALIGNMENT == 32
@@ -90,6 +95,8 @@ extern "C" {
 
 /*-----------------------------------------------------------*/
 
+#if defined( __AVR__ )
+
 #include <avr/wdt.h>
 
 /**
@@ -211,6 +218,8 @@ void wdt_interrupt_reset_enable (const uint8_t value)
     }
 }
 
+#endif /* __AVR__ */
+
 /*-----------------------------------------------------------*/
 
 #include "mpu_wrappers.h"
@@ -102,6 +102,53 @@ typedef unsigned char UBaseType_t;
 
 /*-----------------------------------------------------------*/
 
+/* Program memory, used to keep constant tables and strings out of RAM. */
+#include <avr/pgmspace.h>
+
+#define portFLASH                                   PROGMEM
+#define portFLASH_STRING( pcString )                PSTR( pcString )
+#define portFLASH_READ( pvDest, pvSource, uxLength )    memcpy_P( ( pvDest ), ( pvSource ), ( uxLength ) )
+#define portFLASH_READ_BYTE( pvSource )             pgm_read_byte( ( pvSource ) )
+
+/*-----------------------------------------------------------*/
+
+/* Non-volatile storage, used to keep kernel tables across resets. */
+#include <avr/eeprom.h>
+
+#define portEEPROM_READ( pvDest, uxAddress, uxLength )     eeprom_read_block( ( pvDest ), ( const void * ) ( uxAddress ), ( uxLength ) )
+#define portEEPROM_WRITE( pvSource, uxAddress, uxLength )  eeprom_update_block( ( pvSource ), ( void * ) ( uxAddress ), ( uxLength ) )
+
+/* End of the program image in flash, set by the linker.  It moves whenever
+ * code or initialised data anywhere in the link changes size, even when the
+ * library objects come from the build cache.
+ */
+extern const char __data_load_end[];
+
+#define portPROGRAM_END_ADDRESS()   ( ( portPOINTER_SIZE_TYPE ) __data_load_end )
+
+/*-----------------------------------------------------------*/
+
+/* Run time statistics.  Timer1 counts at F_CPU / 64, which is 4 us at
+ * 16 MHz, and its overflows extend it to 32 bits.
+ */
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+extern void vPortSetupRunTimeCounter( void );
+extern uint32_t ulPortGetRunTimeCounter( void );
+
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    vPortSetupRunTimeCounter()
+#define portGET_RUN_TIME_COUNTER_VALUE()            ulPortGetRunTimeCounter()
+#define portRUN_TIME_COUNTS_PER_TICK    ( ( uint32_t ) ( configCPU_CLOCK_HZ / 64 / 1000 ) * portTICK_PERIOD_MS )
+
+/* The overhead profiler reads the same counter, so Timer1 overflows are not
+ * lost on spans longer than 262 ms at 16 MHz, and keeps spans as 16 bits.
+ */
+#define portOVERHEAD_TYPE               uint16_t
+#define portOVERHEAD_COUNTER()          ulPortGetRunTimeCounter()
+#define portOVERHEAD_NS_PER_COUNT       ( ( uint32_t ) ( 64000000000ULL / configCPU_CLOCK_HZ ) )
+#endif
+
+/*-----------------------------------------------------------*/
+
 /* Kernel utilities. */
 extern void vPortYield( void )          __attribute__ ( ( naked ) );
 #define portYIELD()                     vPortYield()
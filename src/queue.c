@@ -33,6 +33,9 @@ all the API functions to use the MPU wrappers.  That should only be done when
 task.h is included from an application file. */
 #define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
+/* Names this file in the call sites of the overhead profiler. */
+#define taskOVERHEAD_FILE 'Q'
+
 #include "Arduino_FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
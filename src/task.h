@@ -184,7 +184,16 @@ in the system. */
  * \defgroup taskENTER_CRITICAL taskENTER_CRITICAL
  * \ingroup SchedulerControl
  */
+#if (configUSE_OVERHEAD_PROFILER == 1)
+#define taskENTER_CRITICAL()                                    \
+  do                                                            \
+  {                                                             \
+    portENTER_CRITICAL();                                       \
+    vOverheadCriticalEnter(taskOVERHEAD_FILE, (uint16_t)__LINE__); \
+  } while (0)
+#else
 #define taskENTER_CRITICAL() portENTER_CRITICAL()
+#endif
 #define taskENTER_CRITICAL_FROM_ISR() portSET_INTERRUPT_MASK_FROM_ISR()
 
 /**
@@ -199,7 +208,16 @@ in the system. */
  * \defgroup taskEXIT_CRITICAL taskEXIT_CRITICAL
  * \ingroup SchedulerControl
  */
+#if (configUSE_OVERHEAD_PROFILER == 1)
+#define taskEXIT_CRITICAL()     \
+  do                            \
+  {                             \
+    vOverheadCriticalExit();    \
+    portEXIT_CRITICAL();        \
+  } while (0)
+#else
 #define taskEXIT_CRITICAL() portEXIT_CRITICAL()
+#endif
 #define taskEXIT_CRITICAL_FROM_ISR(x) portCLEAR_INTERRUPT_MASK_FROM_ISR(x)
 /**
  * task. h
@@ -451,6 +469,29 @@ is used in assert() statements. */
                                  StaticTask_t *const pxTaskBuffer) PRIVILEGED_FUNCTION;
 #endif /* configSUPPORT_STATIC_ALLOCATION */
 
+#define PERIODIC_TASK_PRIORITY 2
+#define APERIODIC_TASK_PRIORITY 1
+
+  /* Stack classes for task descriptors. */
+#define tskSTACK_CLASS_SMALL 0
+#define tskSTACK_CLASS_MEDIUM 1
+#define tskSTACK_CLASS_LARGE 2
+
+  /* A task declared as a constant table entry in flash.  pcName must also be
+     a flash string.  pvParameters is passed to the task unchanged, so it must
+     point to RAM for the print jobs.  arrival is relative to creation. */
+  typedef struct xTASK_DESCRIPTOR
+  {
+    TaskFunction_t pxTaskCode;
+    const char *pcName;
+    void *pvParameters;
+    UBaseType_t uxPriority;
+    TickType_t arrival;
+    TickType_t period;
+    TickType_t duration;
+    uint8_t stackClass;
+  } TaskDescriptor_t;
+
   BaseType_t xTaskCreatePeriodic(TaskFunction_t pxTaskCode,
                                  const char *const pcName,
                                  const configSTACK_DEPTH_TYPE usStackDepth,
@@ -458,18 +499,104 @@ is used in assert() statements. */
                                  UBaseType_t uxPriority,
                                  TaskHandle_t *const pxCreatedTask, TickType_t arrival, TickType_t period, TickType_t duration) PRIVILEGED_FUNCTION;
 
+  BaseType_t xTaskCreateFromDescriptor(const TaskDescriptor_t *pxDescriptors, UBaseType_t uxIndex, TaskHandle_t *const pxCreatedTask) PRIVILEGED_FUNCTION;
+
+  BaseType_t xTaskCreateJob(char kernel,
+                            const char *const pcName,
+                            void *const pvParameters,
+                            UBaseType_t uxPriority,
+                            TaskHandle_t *const pxCreatedTask, TickType_t arrival, TickType_t period, TickType_t duration) PRIVILEGED_FUNCTION;
+
+#if (configUSE_TASK_RECYCLING == 1)
+  void vTaskGetReclaimStats(TickType_t *pxLatencyMax, TickType_t *pxLatencyLast, UBaseType_t *puxRecycled);
+#endif
+
+#if (configUSE_AUTO_PHASE == 1)
+/* Arrival of a 'p' command that asks for xTaskSuggestPhase(). */
+#define tskAUTO_PHASE portMAX_DELAY
+
+  TickType_t xTaskSuggestPhase(TickType_t period, TickType_t duration);
+#endif
+
+  void taskJob(void *parameter);
   void taskPeriodic(void *parameter);
+  void taskPeriodicNumber(void *parameter);
+  void taskAperiodic(void *parameter);
+  void taskAperiodicNumber(void *parameter);
   void vTaskDeleteLogical();
 
   void initialiseServer(TickType_t capacity, TickType_t period);
 
   void setRefill(TickType_t refill);
 
+#if (configUSE_SHARED_JOB_STACK == 1)
+  /* Shared data guarded under the Stack Resource Policy.  ceiling is the
+     shortest period of any job that locks the resource.  Locks must be
+     released in the reverse order they were taken. */
+  typedef struct SRPResource
+  {
+    TickType_t ceiling;
+    TickType_t previousCeiling;
+  } SRPResource_t;
+
+  void vTaskSRPLock(SRPResource_t *resource);
+  void vTaskSRPUnlock(SRPResource_t *resource);
+#endif
+
   void parseInput(char *input);
 
-  void set_print_str(void (*print_str)(char *));
+/* Task ID of a task the registry had no room for. */
+#define tskNO_TASK_ID ((uint8_t)0xFF)
+
+  TaskHandle_t xTaskGetHandleFromId(UBaseType_t uxTaskId);
+  TaskHandle_t xTaskGetHandleFromName(const char *pcName);
+  UBaseType_t uxTaskGetTaskId(TaskHandle_t xTask);
+
+#if (configUSE_TASK_RETIMING == 1)
+  BaseType_t xTaskSetTiming(TaskHandle_t xTask, TickType_t period, TickType_t duration, TickType_t phase);
+#endif
+
+#if (configUSE_MODE_CHANGE == 1)
+#define tskMODE_CHANGE_ABORT 0
+#define tskMODE_CHANGE_IDLE 1
+#define tskMODE_CHANGE_HYPERPERIOD 2
+
+  BaseType_t xTaskModeChangeBegin(TickType_t capacity, TickType_t period);
+  BaseType_t xTaskModeChangeAdd(TaskFunction_t pxTaskCode, const char *const pcName, const configSTACK_DEPTH_TYPE usStackDepth, void *const pvParameters, UBaseType_t uxPriority, TickType_t arrival, TickType_t period, TickType_t duration);
+  BaseType_t xTaskModeChangeRequest(UBaseType_t policy);
+  void vTaskModeChangeCancel(void);
+#endif
+
+#if (configUSE_TRACE_BUFFER == 1)
+  void traceBufferWrite(uint8_t taskId, const char *text, TickType_t value);
+#endif
+
+#if (configUSE_TRACE_RECORDER == 1)
+  /* Writes a kernel event to the trace recorder.  A NULL task is the running
+     task. */
+  void vTraceRecord(uint8_t event, void *task, TickType_t value);
+#endif
+
+  BaseType_t xCommandIntakeStart(void);
+  void commandReceiveFromISR(char c, BaseType_t *pxHigherPriorityTaskWoken);
+
+#if (configUSE_STACK_PROFILING == 1)
+  void reportStackProfile(BaseType_t save);
+#endif
+
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+  void saveTaskSet(void);
+  BaseType_t restoreTaskSet(void);
+  void eraseTaskSet(void);
+#endif
+
+  void set_print_str(void (*print_str)(const char *));
+  void set_print_str_P(void (*print_str)(const char *));
   void set_print_num(void (*print_num)(int));
   void set_print_float(void (*print_fl)(float));
+#if (configUSE_FRAMED_COMMANDS == 1)
+  void set_print_bytes(void (*print_b)(const uint8_t *, uint8_t));
+#endif
 
 /**
  * task. h
@@ -2407,6 +2534,22 @@ constant. */
  */
   void vTaskInternalSetTimeOutState(TimeOut_t *const pxTimeOut) PRIVILEGED_FUNCTION;
 
+#if (configUSE_OVERHEAD_PROFILER == 1)
+/* Call sites are named by line and by the taskOVERHEAD_FILE tag of the file,
+   which kernel sources define before including this header. */
+#ifndef taskOVERHEAD_FILE
+#define taskOVERHEAD_FILE '?'
+#endif
+
+  void vOverheadCriticalEnter(char file, uint16_t line);
+  void vOverheadCriticalExit(void);
+  void vOverheadSuspendAll(char file, uint16_t line);
+  void vOverheadTickStart(void);
+  void vOverheadTickEnd(void);
+
+#define vTaskSuspendAll() vOverheadSuspendAll(taskOVERHEAD_FILE, (uint16_t)__LINE__)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,16 +28,21 @@
 /* Standard includes. */
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 /* Defining MPU_WRAPPERS_INCLUDED_FROM_API_FILE prevents task.h from redefining
 all the API functions to use the MPU wrappers.  That should only be done when
 task.h is included from an application file. */
 #define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
+/* Names this file in the call sites of the overhead profiler. */
+#define taskOVERHEAD_FILE 'T'
+
 /* FreeRTOS includes. */
 #include "Arduino_FreeRTOS.h"
 #include "task.h"
 #include "timers.h"
+#include "stream_buffer.h"
 #include "stack_macros.h"
 
 /* Lint e9021, e961 and e750 are suppressed as a MISRA exception justified
@@ -271,10 +276,30 @@ typedef struct TaskControlBlock_t
 
     TaskFunction_t taskCode;
 
+    uint8_t jobKernel; /*< Kernel run by taskJob(), as an index into jobKernels[]. */
+    uint8_t jobFlags;  /*< tskJOB_ flags saying what the task's creator left to the kernel. */
+
     int cycle;
 
     TickType_t period, duration, arrival;
 
+#if (configUSE_TASK_RETIMING == 1)
+    TickType_t newPeriod, newDuration, newPhase; /*< Timing to apply at the end of a job that was running when it was set. */
+    uint8_t retimePending;
+#endif
+
+#if (configUSE_TASK_RECYCLING == 1)
+    uint8_t recyclable; /*< Set if the TCB and stack can be reused by xTaskCreatePeriodic(). */
+#endif
+
+    uint8_t taskId;       /*< Index of the task in the registry, or tskNO_TASK_ID. */
+    uint8_t registryNext; /*< Next task in the same name bucket of the registry. */
+
+#if (configUSE_SHARED_JOB_STACK == 1)
+    struct TaskControlBlock_t *pxSharedPrev; /*< The job this one preempted on the shared stack. */
+    uint8_t jobStarted;                      /*< Set while the current job has a frame on the shared stack. */
+#endif
+
 #if ((portSTACK_GROWTH > 0) || (configRECORD_STACK_HIGH_ADDRESS == 1))
     StackType_t *pxEndOfStack; /*< Points to the highest valid address for the stack. */
 #endif
@@ -301,8 +326,18 @@ typedef struct TaskControlBlock_t
     void *pvThreadLocalStoragePointers[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
 #endif
 
+#if (configUSE_OVERHEAD_PROFILER == 1)
+    uint32_t overheadElapsed; /*< Time already spent in the critical section the task was switched out in. */
+    uint16_t overheadLine;
+    char overheadFile;
+    uint8_t overheadNesting; /*< Critical section nesting the task was switched out with. */
+#endif
+
 #if (configGENERATE_RUN_TIME_STATS == 1)
     uint32_t ulRunTimeCounter; /*< Stores the amount of time the task has spent in the Running state. */
+    uint32_t ulJobStartRunTime; /*< ulRunTimeCounter when the current job started. */
+    uint32_t ulMaxJobRunTime;   /*< Longest job so far, in run time counter units. */
+    uint16_t usOverruns;        /*< Jobs that ran for longer than the duration. */
 #endif
 
 #if (configUSE_NEWLIB_REENTRANT == 1)
@@ -362,8 +397,19 @@ PRIVILEGED_DATA static List_t xPendingReadyList;                       /*< Tasks
 PRIVILEGED_DATA static List_t xTasksWaitingTermination; /*< Tasks that have been deleted - but their memory not yet freed. */
 PRIVILEGED_DATA static volatile UBaseType_t uxDeletedTasksWaitingCleanUp = (UBaseType_t)0U;
 
+#if (configUSE_TASK_RECYCLING == 1)
+
+PRIVILEGED_DATA static List_t xRecycledTasks;          /*< Deleted tasks whose TCB and stack are kept for reuse. */
+PRIVILEGED_DATA static TickType_t xReclaimLatencyMax = 0;  /*< Longest time a self deleted task waited to be reclaimed. */
+PRIVILEGED_DATA static TickType_t xReclaimLatencyLast = 0;
+PRIVILEGED_DATA static UBaseType_t uxTasksRecycled = 0;
+
+#endif
+
 #endif
 
+PRIVILEGED_DATA static List_t xBatchTasks; /*< Tasks created by an open batch command, not yet ready. */
+
 #if (INCLUDE_vTaskSuspend == 1)
 
 PRIVILEGED_DATA static List_t xSuspendedTaskList; /*< Tasks that are currently suspended. */
@@ -739,25 +785,66 @@ BaseType_t xTaskCreateRestricted(const TaskParameters_t *const pxTaskDefinition,
 
 //project
 
-#define PERIODIC_TASK_PRIORITY 2
-#define APERIODIC_TASK_PRIORITY 1
 #define MAX_REFILLS 2
 #define MAX_TASK_NAME_LENGTH 5
 
-#define MAX_TASKS_INPUT 3
+/* Bits of jobFlags.  The name and parameter of a task created by the command
+parser are freed with the task.  Tasks created by commands or added to a mode
+change are retired by the next mode change. */
+#define tskJOB_OWNS_STRINGS ((uint8_t)0x01)
+#define tskJOB_MODE_MEMBER ((uint8_t)0x02)
 
-#define WORD_FUNCTION 0
-#define NUMBER_FUNCTION 1
+/* Tasks that commands may delete: jobs, as opposed to the idle, timer and
+command tasks. */
+#define taskIS_JOB(pxTCB) ((((pxTCB)->uxPriority == APERIODIC_TASK_PRIORITY) || ((pxTCB)->uxPriority == PERIODIC_TASK_PRIORITY && (pxTCB)->period > 0)) ? pdTRUE : pdFALSE)
 
-void (*print_string)(char *);
+void (*print_string)(const char *);
+void (*print_string_P)(const char *);
 void (*print_number)(int);
 void (*print_float)(float);
 
-void set_print_str(void (*print_str)(char *))
+void set_print_str(void (*print_str)(const char *))
 {
     print_string = print_str;
 }
 
+void set_print_str_P(void (*print_str)(const char *))
+{
+    print_string_P = print_str;
+}
+
+/* Prints a string held in flash.  Without a flash printer the string is
+copied out to RAM a few characters at a time. */
+static void print_flash(const char *string)
+{
+    char buffer[8];
+    uint8_t i;
+
+    if (print_string_P != NULL)
+    {
+        print_string_P(string);
+        return;
+    }
+
+    do
+    {
+        for (i = 0; i < sizeof(buffer) - 1; i++)
+        {
+            buffer[i] = (char)portFLASH_READ_BYTE(string++);
+
+            if (buffer[i] == 0)
+            {
+                break;
+            }
+        }
+        buffer[i] = 0;
+        print_string(buffer);
+    } while (i == sizeof(buffer) - 1);
+}
+
+/* Kernel log text is kept in flash. */
+#define print_literal(s) print_flash(portFLASH_STRING(s))
+
 void set_print_num(void (*print_num)(int))
 {
     print_number = print_num;
@@ -767,880 +854,4789 @@ void set_print_float(void (*print_fl)(float))
     print_float = print_fl;
 }
 
-static TickType_t serverCapacity = 5;
-static TickType_t serverPeriod = 10;
+#if (configUSE_TASK_SET_SNAPSHOT == 1) || (configUSE_FRAMED_COMMANDS == 1)
 
-struct parameters
+/* CRC-16/CCITT, used to check data kept outside RAM or sent over serial. */
+static uint16_t crc16Update(uint16_t crc, uint8_t data)
 {
-    BaseType_t taskType;
-    TickType_t arrival;
-    TickType_t period;
-    TickType_t duration;
-    BaseType_t create;
-    BaseType_t taskFunction;
-    char *taskParam;
-    char taskName[MAX_TASK_NAME_LENGTH + 1];
+    uint8_t i;
 
-} taskParameters[MAX_TASKS_INPUT];
+    crc ^= (uint16_t)data << 8;
 
-struct capacityRefill
-{
-    TickType_t refillTick;
-    TickType_t refillAmount;
+    for (i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
 
-} refills[MAX_REFILLS];
+    return crc;
+}
 
-void setRefill(TickType_t refill)
+static uint16_t crc16Block(uint16_t crc, const void *data, size_t length)
 {
-    unsigned char i;
-    for (i = 0; i < MAX_REFILLS; i++)
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    while (length-- > 0)
     {
-        if (refills[i].refillAmount == 0)
-        {
-            refills[i].refillAmount = refill;
-            refills[i].refillTick = xTickCount + serverPeriod;
-            return;
-        }
+        crc = crc16Update(crc, *bytes++);
     }
+
+    return crc;
 }
 
-void vTaskDeleteLogical()
+#endif
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+/* Framed binary commands.  A frame is
+
+    FRAME_SYNC, length, opcode, payload[length - 1], crc16 (low byte first)
+
+with the CRC taken over length, opcode and payload.  Numbers in the payload
+are unsigned LEB128 varints and strings are NUL terminated, so fields are
+decoded in place from the receive buffer.  Opcodes match the text commands,
+and replies use upper case opcodes. */
+#define FRAME_SYNC 0x7E
+#define FRAME_VERSION 1
+
+#define FRAME_NACK_CRC 1
+#define FRAME_NACK_MALFORMED 2
+#define FRAME_NACK_UNSCHEDULABLE 3
+#define FRAME_NACK_NO_MEMORY 4
+#define FRAME_NACK_NOT_FOUND 5
+
+/* Longest encoding of a TickType_t. */
+#define FRAME_VARINT_SIZE ((sizeof(TickType_t) * 8 + 6) / 7)
+
+static volatile BaseType_t framedMode = pdFALSE;
+
+void (*print_bytes)(const uint8_t *, uint8_t);
+
+void set_print_bytes(void (*print_b)(const uint8_t *, uint8_t))
 {
-    pxCurrentTCB->cycle += 1;
-    restartTask = pxCurrentTCB;
-    portYIELD_WITHIN_API();
+    print_bytes = print_b;
 }
 
-void taskPeriodicNumber(void *parameter)
+static uint8_t *putVarint(uint8_t *out, TickType_t value)
 {
-    char *output = (char *)parameter;
-    TickType_t counter = 0;
-    TickType_t temp = xTickCount - 1;
-
-    while (counter < pxCurrentTCB->duration)
-    {
-        if (temp != xTickCount)
-        {
-            counter++;
-            print_string(output);
-            // print_string(" - tick : ");
-            print_number(xTickCount);
-            print_string("\n");
-            temp = xTickCount;
-        }
-    }
-
-    while (temp == xTickCount)
+    while (value >= 0x80)
     {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
     }
+    *out++ = (uint8_t)value;
 
-    vTaskDeleteLogical();
+    return out;
 }
 
-void taskPeriodic(void *parameter)
+/* Returns NULL if the field runs past the end of the frame. */
+static const uint8_t *getVarint(const uint8_t *in, const uint8_t *end, TickType_t *value)
 {
-    char *output = (char *)parameter;
-    TickType_t counter = 0;
-    TickType_t temp = xTickCount - 1;
+    uint8_t shift = 0;
+
+    *value = 0;
 
-    while (counter < pxCurrentTCB->duration)
+    while (in != NULL && in < end)
     {
-        if (temp != xTickCount)
+        *value |= (TickType_t)(*in & 0x7F) << shift;
+
+        if ((*in++ & 0x80) == 0)
         {
-            counter++;
-            print_string(output);
-            // print_string(" - tick : ");
-            print_number(xTickCount);
-            print_string("\n");
-            temp = xTickCount;
+            return in;
         }
+        shift += 7;
     }
 
-    while (temp == xTickCount)
-    {
-    }
-
-    vTaskDeleteLogical();
+    return NULL;
 }
 
-void taskAperiodicNumber(void *parameter)
+static const uint8_t *getString(const uint8_t *in, const uint8_t *end, const char **value)
 {
-    char *output = (char *)parameter;
-    TickType_t counter = 0;
-    TickType_t temp = xTickCount - 1;
+    *value = (const char *)in;
 
-    while (counter < pxCurrentTCB->duration)
+    while (in != NULL && in < end)
     {
-        if (temp != xTickCount)
+        if (*in++ == 0)
         {
-            counter++;
-            print_string(output);
-            // print_string(" - tick : ");
-            print_number(xTickCount);
-            print_string("\n");
-            temp = xTickCount;
+            return in;
         }
     }
 
-    while (temp == xTickCount)
+    return NULL;
+}
+
+/* Frames reach the serial line from the idle task alone, so two frames never
+interleave there.  The command task, the only other sender, queues its frames
+in frameStream, and the idle task copies them out whole before it writes any
+of its own.  Frames are never sent from an interrupt. */
+static StreamBufferHandle_t frameStream = NULL;
+
+/* Bytes of the queued frame being copied out that are still to come. */
+static uint16_t frameOutputRemaining = 0;
+
+static uint16_t frameCountByte(uint16_t remaining, uint8_t c);
+
+static void frameOutput(const uint8_t *bytes, uint8_t length)
+{
+    size_t sent = 0;
+    size_t chunk;
+
+    if (frameStream == NULL || xSchedulerRunning == pdFALSE || pxCurrentTCB == xIdleTaskHandle)
     {
+        print_bytes(bytes, length);
+        return;
     }
 
-    vTaskDelete(NULL);
+    /* Waits for the idle task to make room. */
+    while (sent < length)
+    {
+        chunk = length - sent;
+
+        if (chunk > configFRAME_OUTPUT_SIZE)
+        {
+            chunk = configFRAME_OUTPUT_SIZE;
+        }
+        sent += xStreamBufferSend(frameStream, &bytes[sent], chunk, portMAX_DELAY);
+    }
 }
 
-void taskAperiodic(void *parameter)
+/* Called by the idle task.  Returns pdFALSE while a queued frame has only
+partly arrived, when the idle task must not start a frame of its own. */
+static BaseType_t frameOutputDrain(void)
 {
-    char *output = (char *)parameter;
-    TickType_t counter = 0;
-    TickType_t temp = xTickCount - 1;
+    uint8_t bytes[8];
+    size_t count;
+    size_t i;
 
-    while (counter < pxCurrentTCB->duration)
+    if (frameStream == NULL)
     {
-        if (temp != xTickCount)
-        {
-            counter++;
-            print_string(output);
-            // print_string(" - tick : ");
-            print_number(xTickCount);
-            print_string("\n");
-            temp = xTickCount;
-            serverCapacity--;
-        }
+        return pdTRUE;
     }
 
-    while (temp == xTickCount)
+    while ((count = xStreamBufferReceive(frameStream, bytes, sizeof(bytes), 0)) > 0)
     {
+        for (i = 0; i < count; i++)
+        {
+            frameOutputRemaining = frameCountByte(frameOutputRemaining, bytes[i]);
+        }
+        print_bytes(bytes, (uint8_t)count);
     }
 
-    vTaskDelete(NULL);
+    return (frameOutputRemaining == 0) ? pdTRUE : pdFALSE;
 }
 
-void initialiseServer(TickType_t capacity, TickType_t period)
+static void sendFrame(uint8_t opcode, const uint8_t *payload, uint8_t length)
 {
+    uint8_t header[3] = {FRAME_SYNC, (uint8_t)(length + 1), opcode};
+    uint16_t crc = crc16Block(0xFFFF, &header[1], 2);
+    uint8_t trailer[2];
 
-    serverCapacity = capacity;
-    serverPeriod = period;
+    crc = crc16Block(crc, payload, length);
+    trailer[0] = (uint8_t)crc;
+    trailer[1] = (uint8_t)(crc >> 8);
 
-    print_string("C:");
-    print_number(serverCapacity);
-    print_string(" P:");
-    print_number(serverPeriod);
-    print_string("\n");
-    return;
+    frameOutput(header, sizeof(header));
+    frameOutput(payload, length);
+    frameOutput(trailer, sizeof(trailer));
 }
 
-#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+static void sendNack(uint8_t opcode, uint8_t reason)
+{
+    uint8_t payload[2] = {opcode, reason};
 
-BaseType_t xTaskCreatePeriodic(TaskFunction_t pxTaskCode,
-                               const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
-                               const configSTACK_DEPTH_TYPE usStackDepth,
-                               void *const pvParameters,
-                               UBaseType_t uxPriority,
-                               TaskHandle_t *const pxCreatedTask, TickType_t arrival, TickType_t period, TickType_t duration)
+    sendFrame('N', payload, sizeof(payload));
+}
+
+#endif /* configUSE_FRAMED_COMMANDS */
+
+#if (configUSE_TRACE_BUFFER == 1)
+
+/* Job output is queued as binary events and printed by the idle task, so the
+time a job takes does not depend on the serial line.  Unlike refillNotices,
+the ring has several producers, as a job can be preempted in the middle of a
+write by one with a shorter period, and an AVR cannot bump an index
+atomically.  A producer only holds interrupts off while it reserves a slot,
+then fills it and marks it full.  The idle task is the only consumer and
+takes slots in order, stopping at the first one still being written.  Each
+event keeps the start of the job's text, as the job may be deleted, and its
+text freed, before the event is printed. */
+struct traceEvent
 {
-    TCB_t *pxNewTCB;
-    BaseType_t xReturn;
+    volatile uint8_t full;
+    uint8_t taskId;
+    TickType_t tick;
+    TickType_t value;
+    char text[configTRACE_TEXT_LENGTH];
+};
 
-    StackType_t *pxStack;
+static struct traceEvent traceBuffer[configTRACE_BUFFER_SIZE];
 
-    /* Allocate space for the stack used by the task being created. */
-    pxStack = (StackType_t *)pvPortMalloc((((size_t)usStackDepth) * sizeof(StackType_t)));
+/* Free running indices, masked when used. */
+static uint8_t traceHead = 0;
+static volatile uint8_t traceTail = 0;
 
-    if (pxStack != NULL)
-    {
-        /* Allocate space for the TCB. */
-        pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t));
+static uint16_t traceDropped = 0;
 
-        if (pxNewTCB != NULL)
+void traceBufferWrite(uint8_t taskId, const char *text, TickType_t value)
+{
+    struct traceEvent *event = NULL;
+
+    taskENTER_CRITICAL();
+    {
+        if ((uint8_t)(traceHead - traceTail) < configTRACE_BUFFER_SIZE)
         {
-            /* Store the stack location in the TCB. */
-            pxNewTCB->pxStack = pxStack;
+            event = &traceBuffer[traceHead & (configTRACE_BUFFER_SIZE - 1)];
+            traceHead++;
         }
         else
         {
-            /* The stack cannot be used as the TCB was not created.  Free
-                        it again. */
-            vPortFree(pxStack);
+            traceDropped++;
         }
     }
-    else
-    {
-        pxNewTCB = NULL;
-    }
+    taskEXIT_CRITICAL();
 
-    if (pxNewTCB != NULL)
-    {
-        prvInitialiseNewTask(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, pxNewTCB, NULL);
-        pxNewTCB->arrival = arrival;
-        pxNewTCB->duration = duration;
-        pxNewTCB->period = period;
-        pxNewTCB->cycle = 0;
-        pxNewTCB->pvParameters = pvParameters;
-        pxNewTCB->stackDepth = usStackDepth;
-        pxNewTCB->taskCode = pxTaskCode;
-        pxNewTCB->pcName = pcName;
-        prvAddNewTaskToReadyList(pxNewTCB);
-        xReturn = pdPASS;
-    }
-    else
+    if (event != NULL)
     {
-        xReturn = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+        event->taskId = taskId;
+        event->tick = xTickCount;
+        event->value = value;
+        strncpy(event->text, (text != NULL) ? text : "", configTRACE_TEXT_LENGTH - 1);
+        event->text[configTRACE_TEXT_LENGTH - 1] = 0;
+        event->full = 1;
     }
-
-    return xReturn;
 }
 
-BaseType_t xTaskCreate(TaskFunction_t pxTaskCode,
-                       const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
-                       const configSTACK_DEPTH_TYPE usStackDepth,
-                       void *const pvParameters,
-                       UBaseType_t uxPriority,
-                       TaskHandle_t *const pxCreatedTask)
+static void traceBufferDrain(void)
 {
-    TCB_t *pxNewTCB;
-    BaseType_t xReturn;
-
-/* If the stack grows down then allocate the stack then the TCB so the stack
-        does not grow into the TCB.  Likewise if the stack grows up then allocate
-        the TCB then the stack. */
-#if (portSTACK_GROWTH > 0)
-    {
-        /* Allocate space for the TCB.  Where the memory comes from depends on
-            the implementation of the port malloc function and whether or not static
-            allocation is being used. */
-        pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t));
-
-        if (pxNewTCB != NULL)
-        {
-            /* Allocate space for the stack used by the task being created.
-                The base of the stack memory stored in the TCB so the task can
-                be deleted later if required. */
-            pxNewTCB->pxStack = (StackType_t *)pvPortMalloc((((size_t)usStackDepth) * sizeof(StackType_t))); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+    struct traceEvent *event = &traceBuffer[traceTail & (configTRACE_BUFFER_SIZE - 1)];
+    uint16_t dropped;
 
-            if (pxNewTCB->pxStack == NULL)
-            {
-                /* Could not allocate the stack.  Delete the allocated TCB. */
-                vPortFree(pxNewTCB);
-                pxNewTCB = NULL;
-            }
-        }
-    }
-#else  /* portSTACK_GROWTH */
+    while (event->full != 0)
     {
-        StackType_t *pxStack;
-
-        /* Allocate space for the stack used by the task being created. */
-        pxStack = (StackType_t *)pvPortMalloc((((size_t)usStackDepth) * sizeof(StackType_t))); /*lint !e9079 All values returned by pvPortMalloc() have at least the alignment required by the MCU's stack and this allocation is the stack. */
-
-        if (pxStack != NULL)
+#if (configUSE_FRAMED_COMMANDS == 1)
+        if (framedMode != pdFALSE)
         {
-            /* Allocate space for the TCB. */
-            pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t)); /*lint !e9087 !e9079 All values returned by pvPortMalloc() have at least the alignment required by the MCU's stack, and the first member of TCB_t is always a pointer to the task's stack. */
+            uint8_t payload[1 + 2 * FRAME_VARINT_SIZE + configTRACE_TEXT_LENGTH];
+            uint8_t *end;
 
-            if (pxNewTCB != NULL)
-            {
-                /* Store the stack location in the TCB. */
-                pxNewTCB->pxStack = pxStack;
-            }
-            else
-            {
-                /* The stack cannot be used as the TCB was not created.  Free
-                    it again. */
-                vPortFree(pxStack);
-            }
+            payload[0] = event->taskId;
+            end = putVarint(putVarint(&payload[1], event->tick), event->value);
+            strcpy((char *)end, event->text);
+            sendFrame('E', payload, end + strlen(event->text) + 1 - payload);
         }
         else
+#endif
         {
-            pxNewTCB = NULL;
+            print_literal("E:");
+            print_number(event->taskId);
+            print_literal(" T:");
+            print_number(event->tick);
+            print_literal(" V:");
+            print_number(event->value);
+            print_literal(" S:");
+            print_string(event->text);
+            print_literal("\n");
         }
+
+        event->full = 0;
+        traceTail++;
+        event = &traceBuffer[traceTail & (configTRACE_BUFFER_SIZE - 1)];
     }
-#endif /* portSTACK_GROWTH */
 
-    if (pxNewTCB != NULL)
+    taskENTER_CRITICAL();
     {
-#if (tskSTATIC_AND_DYNAMIC_ALLOCATION_POSSIBLE != 0) /*lint !e9029 !e731 Macro has been consolidated for readability reasons. */
-        {
-            /* Tasks can be created statically or dynamically, so note this
-                task was created dynamically in case it is later deleted. */
-            pxNewTCB->ucStaticallyAllocated = tskDYNAMICALLY_ALLOCATED_STACK_AND_TCB;
-        }
-#endif /* tskSTATIC_AND_DYNAMIC_ALLOCATION_POSSIBLE */
-
-        prvInitialiseNewTask(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, pxNewTCB, NULL);
-        prvAddNewTaskToReadyList(pxNewTCB);
-        xReturn = pdPASS;
+        dropped = traceDropped;
+        traceDropped = 0;
     }
-    else
+    taskEXIT_CRITICAL();
+
+    if (dropped > 0)
     {
-        xReturn = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+        print_literal("E:lost ");
+        print_number(dropped);
+        print_literal("\n");
     }
-
-    return xReturn;
 }
 
-#endif /* configSUPPORT_DYNAMIC_ALLOCATION */
-/*-----------------------------------------------------------*/
+/* Job output for one tick of execution. */
+#define jobOutput(output, counter) traceBufferWrite(pxCurrentTCB->taskId, (output), (counter))
 
-static void prvInitialiseNewTask(TaskFunction_t pxTaskCode,
-                                 const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
-                                 const configSTACK_DEPTH_TYPE ulStackDepth,
-                                 void *const pvParameters,
-                                 UBaseType_t uxPriority,
-                                 TaskHandle_t *const pxCreatedTask,
-                                 TCB_t *pxNewTCB,
-                                 const MemoryRegion_t *const xRegions)
+#else
+
+#define jobOutput(output, counter) \
+    do                             \
+    {                              \
+        (void)(counter);           \
+        print_string(output);      \
+        print_number(xTickCount);  \
+        print_literal("\n");       \
+    } while (0)
+
+#endif /* configUSE_TRACE_BUFFER */
+
+static TickType_t serverCapacity = 5;
+static TickType_t serverPeriod = 10;
+
+struct capacityRefill
 {
-    StackType_t *pxTopOfStack;
-    UBaseType_t x;
+    TickType_t refillTick;
+    TickType_t refillAmount;
 
-#if (portUSING_MPU_WRAPPERS == 1)
-    /* Should the task be created in privileged mode? */
-    BaseType_t xRunPrivileged;
-    if ((uxPriority & portPRIVILEGE_BIT) != 0U)
+} refills[MAX_REFILLS];
+
+/* Ticks at which server capacity was given back, queued by the tick
+interrupt and printed by the idle task, so the interrupt never waits on the
+serial line.  The tick interrupt is the only writer of refillNoticeHead and
+the idle task the only writer of refillNoticeTail, so neither side needs a
+critical section.  Notices that find the queue full are counted. */
+#define REFILL_NOTICES 8
+
+static TickType_t refillNotices[REFILL_NOTICES];
+
+/* Free running indices, masked when used. */
+static volatile uint8_t refillNoticeHead = 0;
+static volatile uint8_t refillNoticeTail = 0;
+
+static volatile uint8_t refillNoticesDropped = 0;
+
+/* Called from the tick interrupt. */
+static void refillNoticePost(TickType_t tick)
+{
+    if ((uint8_t)(refillNoticeHead - refillNoticeTail) < REFILL_NOTICES)
     {
-        xRunPrivileged = pdTRUE;
+        refillNotices[refillNoticeHead & (REFILL_NOTICES - 1)] = tick;
+        refillNoticeHead++;
     }
-    else
+    else if (refillNoticesDropped < UINT8_MAX)
     {
-        xRunPrivileged = pdFALSE;
+        refillNoticesDropped++;
     }
-    uxPriority &= ~portPRIVILEGE_BIT;
-#endif /* portUSING_MPU_WRAPPERS == 1 */
+}
 
-/* Avoid dependency on memset() if it is not required. */
-#if (tskSET_NEW_STACKS_TO_KNOWN_VALUE == 1)
-    {
-        /* Fill the stack with a known value to assist debugging. */
-        (void)memset(pxNewTCB->pxStack, (int)tskSTACK_FILL_BYTE, (size_t)ulStackDepth * sizeof(StackType_t));
-    }
-#endif /* tskSET_NEW_STACKS_TO_KNOWN_VALUE */
+static void refillNoticesDrain(void)
+{
+    TickType_t tick;
+    uint8_t dropped;
 
-/* Calculate the top of stack address.  This depends on whether the stack
-    grows from high memory to low (as per the 80x86) or vice versa.
-    portSTACK_GROWTH is used to make the result positive or negative as required
-    by the port. */
-#if (portSTACK_GROWTH < 0)
+    while (refillNoticeTail != refillNoticeHead)
     {
-        pxTopOfStack = &(pxNewTCB->pxStack[ulStackDepth - (configSTACK_DEPTH_TYPE)1]);
-        pxTopOfStack = (StackType_t *)(((portPOINTER_SIZE_TYPE)pxTopOfStack) & (~((portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK))); /*lint !e923 !e9033 !e9078 MISRA exception.  Avoiding casts between pointers and integers is not practical.  Size differences accounted for using portPOINTER_SIZE_TYPE type.  Checked by assert(). */
+        tick = refillNotices[refillNoticeTail & (REFILL_NOTICES - 1)];
+        refillNoticeTail++;
 
-        /* Check the alignment of the calculated top of stack is correct. */
-        configASSERT((((portPOINTER_SIZE_TYPE)pxTopOfStack & (portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK) == 0UL));
-
-#if (configRECORD_STACK_HIGH_ADDRESS == 1)
+#if (configUSE_FRAMED_COMMANDS == 1)
+        if (framedMode != pdFALSE)
         {
-            /* Also record the stack's high address, which may assist
-            debugging. */
-            pxNewTCB->pxEndOfStack = pxTopOfStack;
+            uint8_t payload[FRAME_VARINT_SIZE];
+
+            sendFrame('R', payload, putVarint(payload, tick) - payload);
+            continue;
         }
-#endif /* configRECORD_STACK_HIGH_ADDRESS */
+#endif
+        print_literal("R:");
+        print_number(tick);
+        print_literal("\n");
     }
-#else  /* portSTACK_GROWTH */
-    {
-        pxTopOfStack = pxNewTCB->pxStack;
 
-        /* Check the alignment of the stack buffer is correct. */
-        configASSERT((((portPOINTER_SIZE_TYPE)pxNewTCB->pxStack & (portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK) == 0UL));
+    if (refillNoticesDropped > 0)
+    {
+        taskENTER_CRITICAL();
+        {
+            dropped = refillNoticesDropped;
+            refillNoticesDropped = 0;
+        }
+        taskEXIT_CRITICAL();
 
-        /* The other extreme of the stack space is required if stack checking is
-        performed. */
-        pxNewTCB->pxEndOfStack = pxNewTCB->pxStack + (ulStackDepth - (configSTACK_DEPTH_TYPE)1);
+        print_literal("R:lost ");
+        print_number(dropped);
+        print_literal("\n");
     }
-#endif /* portSTACK_GROWTH */
+}
 
-    /* Store the task name in the TCB. */
-    if (pcName != NULL)
+/* Task registry.  Every task is given a small ID when it is created, which
+indexes taskRegistry, and is chained into a bucket by a hash of its name, so
+commands find a task in any state without scanning the task lists.  Free IDs
+are kept on a stack.  Tasks created once the registry is full run without
+an ID, and are found by name by scanning the job ready lists. */
+static TCB_t *taskRegistry[configTASK_REGISTRY_SIZE];
+static uint8_t registryBuckets[configTASK_REGISTRY_SIZE];
+static uint8_t registryFree[configTASK_REGISTRY_SIZE];
+static uint8_t registryFreeCount = 0;
+static UBaseType_t registryUnindexed = 0; /*< Tasks alive without an ID. */
+
+static void registryInitialise(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < configTASK_REGISTRY_SIZE; i++)
     {
-        for (x = (UBaseType_t)0; x < (UBaseType_t)configMAX_TASK_NAME_LEN; x++)
-        {
-            pxNewTCB->pcTaskName[x] = pcName[x];
+        taskRegistry[i] = NULL;
+        registryBuckets[i] = tskNO_TASK_ID;
+        registryFree[i] = configTASK_REGISTRY_SIZE - 1 - i;
+    }
+    registryFreeCount = configTASK_REGISTRY_SIZE;
+}
 
-            /* Don't copy all configMAX_TASK_NAME_LEN if the string is shorter than
-        configMAX_TASK_NAME_LEN characters just in case the memory after the
-        string is not accessible (extremely unlikely). */
-            if (pcName[x] == (char)0x00)
-            {
-                break;
-            }
-            else
-            {
-                mtCOVERAGE_TEST_MARKER();
-            }
-        }
+static uint8_t registryHash(const char *name)
+{
+    uint8_t hash = 0;
 
-        /* Ensure the name string is terminated in the case that the string length
-    was greater or equal to configMAX_TASK_NAME_LEN. */
-        pxNewTCB->pcTaskName[configMAX_TASK_NAME_LEN - 1] = '\0';
-    }
-    else
+    while (*name != 0)
     {
-        /* The task has not been given a name, so just ensure there is a NULL
-        terminator when it is read out. */
-        pxNewTCB->pcTaskName[0] = 0x00;
+        hash = (uint8_t)(hash * 31 + *name++);
     }
 
-    /* This is used as an array index so must ensure it's not too large.  First
-    remove the privilege bit if one is present. */
-    if (uxPriority >= (UBaseType_t)configMAX_PRIORITIES)
+    return hash % configTASK_REGISTRY_SIZE;
+}
+
+/* Called with interrupts disabled. */
+static void registryAdd(TCB_t *pxTCB)
+{
+    uint8_t bucket;
+
+    if (registryFreeCount == 0)
     {
-        uxPriority = (UBaseType_t)configMAX_PRIORITIES - (UBaseType_t)1U;
+        pxTCB->taskId = tskNO_TASK_ID;
+        registryUnindexed++;
+        return;
     }
-    else
+
+    pxTCB->taskId = registryFree[--registryFreeCount];
+    taskRegistry[pxTCB->taskId] = pxTCB;
+
+    bucket = registryHash(pxTCB->pcName);
+    pxTCB->registryNext = registryBuckets[bucket];
+    registryBuckets[bucket] = pxTCB->taskId;
+}
+
+/* Called with interrupts disabled. */
+static void registryRemove(TCB_t *pxTCB)
+{
+    uint8_t *link;
+
+    if (pxTCB->taskId == tskNO_TASK_ID)
     {
-        mtCOVERAGE_TEST_MARKER();
+        registryUnindexed--;
+        return;
     }
 
-    pxNewTCB->uxPriority = uxPriority;
-#if (configUSE_MUTEXES == 1)
+    for (link = &registryBuckets[registryHash(pxTCB->pcName)]; *link != tskNO_TASK_ID; link = &(taskRegistry[*link]->registryNext))
     {
-        pxNewTCB->uxBasePriority = uxPriority;
-        pxNewTCB->uxMutexesHeld = 0;
+        if (*link == pxTCB->taskId)
+        {
+            *link = pxTCB->registryNext;
+            break;
+        }
     }
-#endif /* configUSE_MUTEXES */
 
-    vListInitialiseItem(&(pxNewTCB->xStateListItem));
-    vListInitialiseItem(&(pxNewTCB->xEventListItem));
+    taskRegistry[pxTCB->taskId] = NULL;
+    registryFree[registryFreeCount++] = pxTCB->taskId;
+    pxTCB->taskId = tskNO_TASK_ID;
+}
 
-    /* Set the pxNewTCB as a link back from the ListItem_t.  This is so we can get
-    back to    the containing TCB from a generic item in a list. */
-    listSET_LIST_ITEM_OWNER(&(pxNewTCB->xStateListItem), pxNewTCB);
+#if (configUSE_TRACE_RECORDER == 1)
 
-    /* Event lists are always in priority order. */
-    listSET_LIST_ITEM_VALUE(&(pxNewTCB->xEventListItem), (TickType_t)configMAX_PRIORITIES - (TickType_t)uxPriority); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
-    listSET_LIST_ITEM_OWNER(&(pxNewTCB->xEventListItem), pxNewTCB);
+/* Kernel trace recorder.  The trace macros write fixed size records of the
+event, the task ID and the tick into a ring, which the 'g' command drains.
+Records that find the ring full are counted and dropped. */
+struct traceRecord
+{
+    uint8_t event;
+    uint8_t taskId;
+    TickType_t tick;
+    TickType_t value;
+};
 
-#if (portCRITICAL_NESTING_IN_TCB == 1)
+static struct traceRecord traceRecords[configTRACE_RECORDER_SIZE];
+
+/* Free running indices, masked when used. */
+static uint8_t traceRecordHead = 0;
+static uint8_t traceRecordTail = 0;
+
+static uint16_t traceRecordsDropped = 0;
+
+void vTraceRecord(uint8_t event, void *task, TickType_t value)
+{
+    TCB_t *pxTCB = (task != NULL) ? (TCB_t *)task : pxCurrentTCB;
+    struct traceRecord *record;
+
+    taskENTER_CRITICAL();
     {
-        pxNewTCB->uxCriticalNesting = (UBaseType_t)0U;
+        if ((uint8_t)(traceRecordHead - traceRecordTail) < configTRACE_RECORDER_SIZE)
+        {
+            record = &traceRecords[traceRecordHead & (configTRACE_RECORDER_SIZE - 1)];
+            record->event = event;
+            record->taskId = (pxTCB != NULL) ? pxTCB->taskId : tskNO_TASK_ID;
+            record->tick = xTickCount;
+            record->value = value;
+            traceRecordHead++;
+        }
+        else if (traceRecordsDropped < UINT16_MAX)
+        {
+            traceRecordsDropped++;
+        }
     }
-#endif /* portCRITICAL_NESTING_IN_TCB */
+    taskEXIT_CRITICAL();
+}
 
-#if (configUSE_APPLICATION_TASK_TAG == 1)
+/* Takes the oldest record, returning pdFALSE if there is none. */
+static BaseType_t traceRecordTake(struct traceRecord *record)
+{
+    BaseType_t taken = pdFALSE;
+
+    taskENTER_CRITICAL();
     {
-        pxNewTCB->pxTaskTag = NULL;
+        if (traceRecordTail != traceRecordHead)
+        {
+            *record = traceRecords[traceRecordTail & (configTRACE_RECORDER_SIZE - 1)];
+            traceRecordTail++;
+            taken = pdTRUE;
+        }
     }
-#endif /* configUSE_APPLICATION_TASK_TAG */
+    taskEXIT_CRITICAL();
 
-#if (configGENERATE_RUN_TIME_STATS == 1)
+    return taken;
+}
+
+static uint16_t traceRecordsTakeDropped(void)
+{
+    uint16_t dropped;
+
+    taskENTER_CRITICAL();
     {
-        pxNewTCB->ulRunTimeCounter = 0UL;
+        dropped = traceRecordsDropped;
+        traceRecordsDropped = 0;
     }
-#endif /* configGENERATE_RUN_TIME_STATS */
+    taskEXIT_CRITICAL();
 
-#if (portUSING_MPU_WRAPPERS == 1)
+    return dropped;
+}
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+/* Trace, sent as one 'G' frame in reply to 'g':
+
+    records dropped since the last drain,
+    { event, task ID, tick, value } per record, oldest first
+
+Numbers are varints and the rest single bytes.  A frame holds at most
+TRACE_FRAME_RECORDS records, so the host drains until a frame is empty. */
+#define TRACE_RECORD_LENGTH (2 + 2 * FRAME_VARINT_SIZE)
+#define TRACE_FRAME_RECORDS 16
+
+static void traceRecordsSend(void)
+{
+    struct traceRecord record;
+    uint8_t *payload;
+    uint8_t *end;
+    uint8_t i;
+
+    payload = (uint8_t *)pvPortMalloc(FRAME_VARINT_SIZE + TRACE_FRAME_RECORDS * TRACE_RECORD_LENGTH);
+
+    if (payload == NULL)
     {
-        vPortStoreTaskMPUSettings(&(pxNewTCB->xMPUSettings), xRegions, pxNewTCB->pxStack, ulStackDepth);
+        sendNack('g', FRAME_NACK_NO_MEMORY);
+        return;
     }
-#else
+
+    end = putVarint(payload, traceRecordsTakeDropped());
+
+    for (i = 0; i < TRACE_FRAME_RECORDS && traceRecordTake(&record) != pdFALSE; i++)
     {
-        /* Avoid compiler warning about unreferenced parameter. */
-        (void)xRegions;
+        *end++ = record.event;
+        *end++ = record.taskId;
+        end = putVarint(end, record.tick);
+        end = putVarint(end, record.value);
     }
-#endif
 
-#if (configNUM_THREAD_LOCAL_STORAGE_POINTERS != 0)
+    sendFrame('G', payload, end - payload);
+    vPortFree(payload);
+}
+
+#endif /* configUSE_FRAMED_COMMANDS */
+
+/* Prints every record held, then the number dropped if any. */
+static void traceRecordsReport(void)
+{
+    struct traceRecord record;
+    char event[2] = {0, 0};
+    uint16_t dropped;
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
     {
-        for (x = 0; x < (UBaseType_t)configNUM_THREAD_LOCAL_STORAGE_POINTERS; x++)
-        {
-            pxNewTCB->pvThreadLocalStoragePointers[x] = NULL;
-        }
+        traceRecordsSend();
+        return;
     }
 #endif
 
-#if (configUSE_TASK_NOTIFICATIONS == 1)
+    dropped = traceRecordsTakeDropped();
+
+    while (traceRecordTake(&record) != pdFALSE)
     {
-        pxNewTCB->ulNotifiedValue = 0;
-        pxNewTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+        event[0] = (char)record.event;
+        print_literal("G:");
+        print_string(event);
+        print_literal(" ");
+        print_number(record.taskId);
+        print_literal(" ");
+        print_number(record.tick);
+        print_literal(" ");
+        print_number(record.value);
+        print_literal("\n");
     }
-#endif
 
-#if (configUSE_NEWLIB_REENTRANT == 1)
+    if (dropped > 0)
     {
-        /* Initialise this task's Newlib reent structure. */
-        _REENT_INIT_PTR((&(pxNewTCB->xNewLib_reent)));
+        print_literal("G:lost ");
+        print_number(dropped);
+        print_literal("\n");
     }
-#endif
+}
 
-#if (INCLUDE_xTaskAbortDelay == 1)
+#endif /* configUSE_TRACE_RECORDER */
+
+TaskHandle_t xTaskGetHandleFromId(UBaseType_t uxTaskId)
+{
+    TCB_t *pxTCB = NULL;
+
+    if (uxTaskId < configTASK_REGISTRY_SIZE)
     {
-        pxNewTCB->ucDelayAborted = pdFALSE;
+        taskENTER_CRITICAL();
+        {
+            pxTCB = taskRegistry[uxTaskId];
+        }
+        taskEXIT_CRITICAL();
     }
-#endif
 
-/* Initialize the TCB stack to look as if the task was already running,
-    but had been interrupted by the scheduler.  The return address is set
-    to the start of the task function. Once the stack has been initialised
-    the top of stack variable is updated. */
-#if (portUSING_MPU_WRAPPERS == 1)
+    return pxTCB;
+}
+
+/* Finds a task without a registry ID in a ready list.  Called with interrupts
+disabled. */
+static TCB_t *registryScan(const List_t *pxList, const char *pcName)
+{
+    const ListItem_t *item;
+    TCB_t *temp;
+
+    for (item = listGET_HEAD_ENTRY(pxList); item != listGET_END_MARKER(pxList); item = listGET_NEXT(item))
     {
-/* If the port has capability to detect stack overflow,
-        pass the stack end address to the stack initialization
-        function as well. */
-#if (portHAS_STACK_OVERFLOW_CHECKING == 1)
+        temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
+
+        if (temp->taskId == tskNO_TASK_ID && strcmp(temp->pcName, pcName) == 0)
         {
-#if (portSTACK_GROWTH < 0)
-            {
-                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxStack, pxTaskCode, pvParameters, xRunPrivileged);
-            }
-#else  /* portSTACK_GROWTH */
+            return temp;
+        }
+    }
+
+    return NULL;
+}
+
+TaskHandle_t xTaskGetHandleFromName(const char *pcName)
+{
+    TCB_t *pxTCB = NULL;
+    uint8_t id;
+
+    taskENTER_CRITICAL();
+    {
+        for (id = registryBuckets[registryHash(pcName)]; id != tskNO_TASK_ID; id = taskRegistry[id]->registryNext)
+        {
+            if (strcmp(taskRegistry[id]->pcName, pcName) == 0)
             {
-                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxEndOfStack, pxTaskCode, pvParameters, xRunPrivileged);
+                pxTCB = taskRegistry[id];
+                break;
             }
-#endif /* portSTACK_GROWTH */
         }
-#else  /* portHAS_STACK_OVERFLOW_CHECKING */
+
+        /* Jobs created once the registry was full stay on the ready lists. */
+        if (pxTCB == NULL && registryUnindexed > 0)
         {
-            pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxTaskCode, pvParameters, xRunPrivileged);
+            pxTCB = registryScan(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]), pcName);
+
+            if (pxTCB == NULL)
+            {
+                pxTCB = registryScan(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]), pcName);
+            }
         }
-#endif /* portHAS_STACK_OVERFLOW_CHECKING */
     }
-#else /* portUSING_MPU_WRAPPERS */
+    taskEXIT_CRITICAL();
+
+    return pxTCB;
+}
+
+UBaseType_t uxTaskGetTaskId(TaskHandle_t xTask)
+{
+    return prvGetTCBFromHandle(xTask)->taskId;
+}
+
+#if (configUSE_SHARED_JOB_STACK == 1)
+
+/* Periodic jobs always run to completion and restart from the top, so under
+the Stack Resource Policy a job can only be preempted by a job with a shorter
+period, and must finish before the job it preempted resumes.  All job frames
+therefore nest on a single stack.  A job's frame is only placed when it is
+first dispatched, directly below the job it preempts. */
+static StackType_t sharedJobStack[configSHARED_JOB_STACK_SIZE];
+static BaseType_t sharedJobStackFilled = pdFALSE;
+
+/* Most recently started job still on the shared stack. */
+static TCB_t *sharedStackHead = NULL;
+
+/* Shortest ceiling of the SRP resources currently locked. */
+static TickType_t systemCeiling = portMAX_DELAY;
+
+#define tskSTACK_IS_SHARED(pxTCB) ((pxTCB)->pxStack == sharedJobStack)
+
+static void sharedStackRemove(TCB_t *job)
+{
+    TCB_t *temp;
+
+    if (sharedStackHead == job)
     {
-/* If the port has capability to detect stack overflow,
-        pass the stack end address to the stack initialization
-        function as well. */
-#if (portHAS_STACK_OVERFLOW_CHECKING == 1)
+        sharedStackHead = job->pxSharedPrev;
+    }
+    else
+    {
+        for (temp = sharedStackHead; temp != NULL; temp = temp->pxSharedPrev)
         {
-#if (portSTACK_GROWTH < 0)
+            if (temp->pxSharedPrev == job)
             {
-                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxStack, pxTaskCode, pvParameters);
+                temp->pxSharedPrev = job->pxSharedPrev;
+                break;
             }
-#else  /* portSTACK_GROWTH */
+        }
+    }
+
+    job->pxSharedPrev = NULL;
+    job->jobStarted = 0;
+}
+
+/* A job that has not started yet may only start if its preemption level is
+above both the running job's and the ceiling of every locked resource. */
+static BaseType_t sharedStackCanStart(TCB_t *job)
+{
+    if (sharedStackHead != NULL && job->period >= sharedStackHead->period)
+    {
+        return pdFALSE;
+    }
+
+    return (job->period < systemCeiling) ? pdTRUE : pdFALSE;
+}
+
+static void sharedStackStart(TCB_t *job)
+{
+    StackType_t *top;
+
+    if (sharedStackHead == NULL)
+    {
+        top = &(sharedJobStack[configSHARED_JOB_STACK_SIZE - (configSTACK_DEPTH_TYPE)1]);
+    }
+    else
+    {
+        top = (StackType_t *)sharedStackHead->pxTopOfStack - configSHARED_JOB_STACK_MARGIN;
+    }
+
+    job->pxTopOfStack = pxPortInitialiseStack(top, job->taskCode, job->pvParameters);
+    job->pxSharedPrev = sharedStackHead;
+    job->jobStarted = 1;
+    sharedStackHead = job;
+}
+
+void vTaskSRPLock(SRPResource_t *resource)
+{
+    taskENTER_CRITICAL();
+    {
+        resource->previousCeiling = systemCeiling;
+
+        if (resource->ceiling < systemCeiling)
+        {
+            systemCeiling = resource->ceiling;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+void vTaskSRPUnlock(SRPResource_t *resource)
+{
+    taskENTER_CRITICAL();
+    {
+        systemCeiling = resource->previousCeiling;
+    }
+    taskEXIT_CRITICAL();
+
+    /* Jobs held back by the ceiling may be able to start now. */
+    portYIELD_WITHIN_API();
+}
+
+#else
+
+#define tskSTACK_IS_SHARED(pxTCB) pdFALSE
+
+#endif /* configUSE_SHARED_JOB_STACK */
+
+/* Schedules refill ticks of capacity to be given back one server period from
+now.  When every slot is pending, the refill is merged into the one due last,
+which is then due with the new one.  Capacity is never given back early, only
+the latest refill's earlier share late, so the server cannot lose capacity to
+a burst of short jobs. */
+void setRefill(TickType_t refill)
+{
+    unsigned char i;
+    unsigned char latest = 0;
+    TickType_t refillTick = xTickCount + serverPeriod;
+
+    for (i = 0; i < MAX_REFILLS; i++)
+    {
+        if (refills[i].refillAmount == 0)
+        {
+            refills[i].refillAmount = refill;
+            refills[i].refillTick = refillTick;
+            traceSERVER_REFILL_SET(refill, refillTick);
+            return;
+        }
+
+        /* Measured from now so that the tick count wrapping does not matter. */
+        if ((TickType_t)(refills[i].refillTick - xTickCount) > (TickType_t)(refills[latest].refillTick - xTickCount))
+        {
+            latest = i;
+        }
+    }
+
+    refills[latest].refillAmount += refill;
+    refills[latest].refillTick = refillTick;
+    traceSERVER_REFILL_SET(refill, refillTick);
+}
+
+#if (configUSE_STACK_PROFILING == 1) || (configUSE_STACK_PROFILE_SIZES == 1)
+
+#define STACK_PROFILE_MAGIC 0x5C
+
+/* Largest stack use seen for each job body, keyed by stackProfileKey(), so
+every task running the same body shares one entry. */
+struct stackProfile
+{
+    portPOINTER_SIZE_TYPE taskCode;
+    configSTACK_DEPTH_TYPE stackUsed;
+};
+
+/* Starts the table in EEPROM.  Keys are code addresses, which move from one
+build to the next, so a table saved by another build is ignored.  A table
+that matched the wrong functions would hand out stacks that are too small. */
+struct stackProfileHeader
+{
+    uint8_t magic;
+    uint16_t buildId;
+};
+
+static portPOINTER_SIZE_TYPE stackProfileKey(TaskFunction_t taskCode, uint8_t kernel);
+
+/* A hash of the time this file was compiled and of where the program ends.
+The library objects, this file's among them, can come from the build cache
+while only the sketch is rebuilt, but the end of the program still moves.  It
+is measured from this function, as the host may load the program anywhere. */
+static uint16_t stackProfileBuildId(void)
+{
+    static const char build[] portFLASH = __DATE__ " " __TIME__;
+    portPOINTER_SIZE_TYPE end = portPROGRAM_END_ADDRESS() - (portPOINTER_SIZE_TYPE)stackProfileBuildId;
+    uint16_t hash = 0;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(build) - 1; i++)
+    {
+        hash = (uint16_t)(hash * 31 + (uint8_t)portFLASH_READ_BYTE(&build[i]));
+    }
+
+    for (i = 0; i < sizeof(end); i++)
+    {
+        hash = (uint16_t)(hash * 31 + (uint8_t)(end >> (8 * i)));
+    }
+
+    return hash;
+}
+
+#endif
+
+#if (configUSE_STACK_PROFILING == 1)
+
+static struct stackProfile stackProfiles[configSTACK_PROFILE_ENTRIES];
+
+static void recordStackUsage(TCB_t *job)
+{
+    portPOINTER_SIZE_TYPE key;
+    configSTACK_DEPTH_TYPE used;
+    uint8_t i;
+
+    /* The shared job stack has no per-job high water mark. */
+    if (tskSTACK_IS_SHARED(job))
+    {
+        return;
+    }
+
+    used = job->stackDepth - prvTaskCheckFreeStackSpace((uint8_t *)job->pxStack);
+    key = stackProfileKey(job->taskCode, job->jobKernel);
+
+    for (i = 0; i < configSTACK_PROFILE_ENTRIES; i++)
+    {
+        if (stackProfiles[i].taskCode == key || stackProfiles[i].taskCode == 0)
+        {
+            stackProfiles[i].taskCode = key;
+
+            if (used > stackProfiles[i].stackUsed)
             {
-                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxEndOfStack, pxTaskCode, pvParameters);
+                stackProfiles[i].stackUsed = used;
             }
-#endif /* portSTACK_GROWTH */
+            return;
         }
-#else  /* portHAS_STACK_OVERFLOW_CHECKING */
+    }
+}
+
+/* Prints the measured use and recommended size of every job function, and
+optionally saves the recommendations for configUSE_STACK_PROFILE_SIZES. */
+void reportStackProfile(BaseType_t save)
+{
+    struct stackProfile saved[configSTACK_PROFILE_ENTRIES];
+    struct stackProfileHeader header;
+    uint8_t i;
+
+    for (i = 0; i < configSTACK_PROFILE_ENTRIES; i++)
+    {
+        saved[i].taskCode = stackProfiles[i].taskCode;
+        saved[i].stackUsed = 0;
+
+        if (stackProfiles[i].taskCode != 0)
         {
-            pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxTaskCode, pvParameters);
+            saved[i].stackUsed = stackProfiles[i].stackUsed + configSTACK_PROFILE_MARGIN;
+
+            print_literal("H:");
+            print_number(stackProfiles[i].taskCode);
+            print_literal(" U:");
+            print_number(stackProfiles[i].stackUsed);
+            print_literal(" R:");
+            print_number(saved[i].stackUsed);
+            print_literal("\n");
         }
-#endif /* portHAS_STACK_OVERFLOW_CHECKING */
     }
-#endif /* portUSING_MPU_WRAPPERS */
 
-    if (pxCreatedTask != NULL)
+    if (save != pdFALSE)
     {
-        /* Pass the handle out in an anonymous way.  The handle can be used to
-        change the created task's priority, delete the created task, etc.*/
-        *pxCreatedTask = (TaskHandle_t)pxNewTCB;
+        header.magic = STACK_PROFILE_MAGIC;
+        header.buildId = stackProfileBuildId();
+
+        portEEPROM_WRITE(saved, configSTACK_PROFILE_EEPROM_ADDRESS + sizeof(header), sizeof(saved));
+        portEEPROM_WRITE(&header, configSTACK_PROFILE_EEPROM_ADDRESS, sizeof(header));
+        print_literal("H:saved\n");
     }
-    else
+}
+
+#endif /* configUSE_STACK_PROFILING */
+
+#if (configUSE_STACK_PROFILE_SIZES == 1)
+
+/* Stack size saved for the job body with this key on an earlier run, if any. */
+static configSTACK_DEPTH_TYPE learnedStackDepth(portPOINTER_SIZE_TYPE key, configSTACK_DEPTH_TYPE requested)
+{
+    struct stackProfileHeader header;
+    struct stackProfile entry;
+    uint8_t i;
+
+    portEEPROM_READ(&header, configSTACK_PROFILE_EEPROM_ADDRESS, sizeof(header));
+
+    if (header.magic != STACK_PROFILE_MAGIC || header.buildId != stackProfileBuildId())
     {
-        mtCOVERAGE_TEST_MARKER();
+        return requested;
+    }
+
+    for (i = 0; i < configSTACK_PROFILE_ENTRIES; i++)
+    {
+        portEEPROM_READ(&entry, configSTACK_PROFILE_EEPROM_ADDRESS + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        if (entry.taskCode == key && entry.stackUsed != 0)
+        {
+            return entry.stackUsed;
+        }
     }
+
+    return requested;
 }
-/*-----------------------------------------------------------*/
 
-static void prvAddNewTaskToReadyList(TCB_t *pxNewTCB)
+#endif /* configUSE_STACK_PROFILE_SIZES */
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+
+/* Run time, in run time counter units, of each class of task.  Aperiodic
+jobs delete themselves, so the server class is what is left of their time. */
+#define RUN_TIME_PERIODIC 0
+#define RUN_TIME_SERVER 1
+#define RUN_TIME_IDLE 2
+#define RUN_TIME_SYSTEM 3
+#define RUN_TIME_CLASSES 4
+
+static uint32_t runTimeClasses[RUN_TIME_CLASSES];
+
+/* Counter units in one tick, measured by the idle task over
+RUN_TIME_CALIBRATION_TICKS since the tick source is not exact. */
+#define RUN_TIME_CALIBRATION_TICKS 64
+
+static uint32_t runTimePerTick = portRUN_TIME_COUNTS_PER_TICK;
+static uint32_t runTimeSample;
+static TickType_t runTimeSampleTick;
+static BaseType_t runTimeSampled = pdFALSE;
+
+static uint8_t runTimeClass(const TCB_t *pxTCB)
 {
-    /* Ensure interrupts don't access the task lists while the lists are being
-    updated. */
+    if (pxTCB == xIdleTaskHandle)
+    {
+        return RUN_TIME_IDLE;
+    }
+    if (pxTCB->uxPriority == APERIODIC_TASK_PRIORITY)
+    {
+        return RUN_TIME_SERVER;
+    }
+
+    return (pxTCB->period > 0) ? RUN_TIME_PERIODIC : RUN_TIME_SYSTEM;
+}
+
+static void runTimeCalibrate(void)
+{
+    TickType_t ticks = xTickCount - runTimeSampleTick;
+    uint32_t now;
+
+    if (runTimeSampled != pdFALSE && ticks < RUN_TIME_CALIBRATION_TICKS)
+    {
+        return;
+    }
+
     taskENTER_CRITICAL();
     {
-        uxCurrentNumberOfTasks++;
-        if (pxCurrentTCB == NULL)
+        now = portGET_RUN_TIME_COUNTER_VALUE();
+        ticks = xTickCount - runTimeSampleTick;
+        runTimeSampleTick = xTickCount;
+    }
+    taskEXIT_CRITICAL();
+
+    if (runTimeSampled != pdFALSE)
+    {
+        runTimePerTick = (now - runTimeSample) / ticks;
+    }
+    runTimeSample = now;
+    runTimeSampled = pdTRUE;
+}
+
+/* Closes the running periodic job, counting it as an overrun if it ran for
+longer than its duration. */
+static void recordJobRunTime(TCB_t *job)
+{
+    uint32_t total, used;
+
+    taskENTER_CRITICAL();
+    {
+        total = job->ulRunTimeCounter + (portGET_RUN_TIME_COUNTER_VALUE() - ulTaskSwitchedInTime);
+        used = total - job->ulJobStartRunTime;
+        job->ulJobStartRunTime = total;
+
+        if (used > job->ulMaxJobRunTime)
         {
-            /* There are no other tasks, or all the other tasks are in
-            the suspended state - make this the current task. */
-            pxCurrentTCB = pxNewTCB;
+            job->ulMaxJobRunTime = used;
+        }
+        if (used > job->duration * runTimePerTick && job->usOverruns < UINT16_MAX)
+        {
+            job->usOverruns++;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
 
-            if (uxCurrentNumberOfTasks == (UBaseType_t)1)
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+static uint8_t *putVarint32(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+
+    return out;
+}
+
+/* Run time table, sent as one 'U' frame in reply to 'u':
+
+    flags, total run time, counter units per tick,
+    { run time } per class (periodic, server, idle, other),
+    task count, { ID, run time, longest job, overruns } per task
+
+Times are varints in run time counter units.  Tasks that do not fit in one
+frame are left out and bit 0 of flags is set, as for the snapshot. */
+#define RUN_TIME_TRUNCATED 0x01
+#define RUN_TIME_LENGTH_MAX 254
+#define RUN_TIME_HEADER_LENGTH (2 + (2 + RUN_TIME_CLASSES) * 5)
+#define RUN_TIME_RECORD_LENGTH (1 + 2 * 5 + FRAME_VARINT_SIZE)
+
+static void runTimeSend(void)
+{
+    uint8_t *table;
+    uint8_t *end;
+    uint8_t *count;
+    uint8_t id;
+    TCB_t *temp;
+
+    table = (uint8_t *)pvPortMalloc(RUN_TIME_LENGTH_MAX);
+
+    if (table == NULL)
+    {
+        sendNack('u', FRAME_NACK_NO_MEMORY);
+        return;
+    }
+
+    vTaskSuspendAll();
+    {
+        /* Counters only move at a context switch, which is held off. */
+        table[0] = 0;
+        end = putVarint32(&table[1], portGET_RUN_TIME_COUNTER_VALUE());
+        end = putVarint32(end, runTimePerTick);
+
+        for (id = 0; id < RUN_TIME_CLASSES; id++)
+        {
+            end = putVarint32(end, runTimeClasses[id]);
+        }
+        count = end++;
+        *count = 0;
+
+        for (id = 0; id < configTASK_REGISTRY_SIZE; id++)
+        {
+            temp = taskRegistry[id];
+
+            if (temp == NULL)
             {
-                /* This is the first task to be created so do the preliminary
-                initialisation required.  We will not recover if this call
-                fails, but we will report the failure. */
-                prvInitialiseTaskLists();
+                continue;
             }
-            else
+            if (end + RUN_TIME_RECORD_LENGTH > table + RUN_TIME_LENGTH_MAX)
             {
-                mtCOVERAGE_TEST_MARKER();
+                table[0] |= RUN_TIME_TRUNCATED;
+                break;
             }
+
+            *end++ = id;
+            end = putVarint32(end, temp->ulRunTimeCounter);
+            end = putVarint32(end, temp->ulMaxJobRunTime);
+            end = putVarint(end, temp->usOverruns);
+            (*count)++;
         }
-        else
-        {
-            /* If the scheduler is not already running, make this task the
-            current task if it is the highest priority task to be created
-            so far. */
-            if (xSchedulerRunning == pdFALSE)
-            {
-                if (pxCurrentTCB->uxPriority <= pxNewTCB->uxPriority)
-                {
-                    pxCurrentTCB = pxNewTCB;
-                }
-                else
-                {
+    }
+    (void)xTaskResumeAll();
+
+    sendFrame('U', table, end - table);
+    vPortFree(table);
+}
+
+#endif /* configUSE_FRAMED_COMMANDS */
+
+/* Reports the share of the run time taken by each class of task and by each
+task, with the longest job of each periodic task in ticks and its overruns. */
+static void reportRunTime(void)
+{
+    static const char classNames[RUN_TIME_CLASSES] portFLASH = {'P', 'S', 'I', 'O'};
+    uint32_t classes[RUN_TIME_CLASSES];
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t counter, maxJobRunTime, perTick;
+    uint16_t overruns;
+    TickType_t period;
+    float total;
+    uint8_t id;
+    TCB_t *temp;
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        runTimeSend();
+        return;
+    }
+#endif
+
+    /* Counters only move at a context switch, so the classes, and then each
+    task, are copied under a short critical section and printed after it.  The
+    scheduler keeps running while the serial line drains. */
+    taskENTER_CRITICAL();
+    {
+        total = (float)portGET_RUN_TIME_COUNTER_VALUE() / 100;
+
+        for (id = 0; id < RUN_TIME_CLASSES; id++)
+        {
+            classes[id] = runTimeClasses[id];
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    print_literal("U:");
+    for (id = 0; id < RUN_TIME_CLASSES; id++)
+    {
+        char className[3] = {(char)portFLASH_READ_BYTE(&classNames[id]), ':', 0};
+
+        if (id > 0)
+        {
+            print_literal(" ");
+        }
+        print_string(className);
+        print_float(classes[id] / total);
+    }
+    print_literal("\n");
+
+    for (id = 0; id < configTASK_REGISTRY_SIZE; id++)
+    {
+        /* A task may be deleted while the previous line is printed. */
+        taskENTER_CRITICAL();
+        {
+            temp = taskRegistry[id];
+
+            if (temp != NULL)
+            {
+                memcpy(name, temp->pcTaskName, configMAX_TASK_NAME_LEN);
+                counter = temp->ulRunTimeCounter;
+                maxJobRunTime = temp->ulMaxJobRunTime;
+                overruns = temp->usOverruns;
+                period = temp->period;
+                perTick = runTimePerTick;
+                total = (float)portGET_RUN_TIME_COUNTER_VALUE() / 100;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if (temp == NULL)
+        {
+            continue;
+        }
+
+        print_literal("U#");
+        print_number(id);
+        print_literal(" ");
+        print_string(name);
+        print_literal(" C:");
+        print_float(counter / total);
+
+        if (period > 0)
+        {
+            print_literal(" J:");
+            print_float((float)maxJobRunTime / perTick);
+            print_literal(" O:");
+            print_number(overruns);
+        }
+        print_literal("\n");
+    }
+}
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+
+#if (configUSE_OVERHEAD_PROFILER == 1)
+
+/* Overhead profiler.  Times the outermost critical section, the outermost
+scheduler suspension and the scheduler's tick interrupt, in counts of the
+port's overhead counter.  Each kind has a log2 histogram and a maximum, and
+critical sections and suspensions also keep the count and maximum of each
+call site, named by file tag and line.  Sites found once the table is full
+go into the histograms only.  The counter is read as 32 bits, and spans too
+long for portOVERHEAD_TYPE are recorded as its largest value. */
+#define OVERHEAD_CRITICAL 0
+#define OVERHEAD_SUSPEND 1
+#define OVERHEAD_TICK 2
+#define OVERHEAD_KINDS 3
+
+#define OVERHEAD_BUCKETS (sizeof(portOVERHEAD_TYPE) * 8 + 1)
+#define OVERHEAD_DURATION_MAX ((portOVERHEAD_TYPE) ~(portOVERHEAD_TYPE)0)
+
+struct overheadSite
+{
+    uint16_t line;
+    char file;
+    uint8_t kind;
+    uint16_t count;
+    portOVERHEAD_TYPE max;
+};
+
+static struct overheadSite overheadSites[configOVERHEAD_SITES];
+static uint16_t overheadHistograms[OVERHEAD_KINDS][OVERHEAD_BUCKETS];
+static portOVERHEAD_TYPE overheadMax[OVERHEAD_KINDS];
+
+/* Where and when the outermost section of each kind began. */
+static uint32_t overheadStart[OVERHEAD_KINDS];
+static uint16_t overheadLine[OVERHEAD_KINDS];
+static char overheadFile[OVERHEAD_KINDS];
+
+/* Nesting of the running task's critical sections.  vTaskSwitchContext()
+keeps it, and the open section, in the TCB while the task is switched out. */
+static uint8_t overheadCriticalNesting = 0;
+
+/* Called with interrupts disabled. */
+static void overheadRecord(uint8_t kind)
+{
+    uint32_t span = (uint32_t)portOVERHEAD_COUNTER() - overheadStart[kind];
+    portOVERHEAD_TYPE duration = (span > OVERHEAD_DURATION_MAX) ? OVERHEAD_DURATION_MAX : (portOVERHEAD_TYPE)span;
+    portOVERHEAD_TYPE ticks = duration;
+    uint8_t bucket = 0;
+    uint8_t i;
+
+    while (ticks != 0)
+    {
+        ticks >>= 1;
+        bucket++;
+    }
+
+    if (overheadHistograms[kind][bucket] < UINT16_MAX)
+    {
+        overheadHistograms[kind][bucket]++;
+    }
+    if (duration > overheadMax[kind])
+    {
+        overheadMax[kind] = duration;
+    }
+
+    if (kind == OVERHEAD_TICK)
+    {
+        return;
+    }
+
+    for (i = 0; i < configOVERHEAD_SITES; i++)
+    {
+        struct overheadSite *site = &overheadSites[i];
+
+        if (site->count == 0)
+        {
+            site->line = overheadLine[kind];
+            site->file = overheadFile[kind];
+            site->kind = kind;
+        }
+        else if (site->line != overheadLine[kind] || site->file != overheadFile[kind] || site->kind != kind)
+        {
+            continue;
+        }
+
+        if (site->count < UINT16_MAX)
+        {
+            site->count++;
+        }
+        if (duration > site->max)
+        {
+            site->max = duration;
+        }
+        return;
+    }
+}
+
+void vOverheadCriticalEnter(char file, uint16_t line)
+{
+    if (overheadCriticalNesting++ == 0)
+    {
+        overheadFile[OVERHEAD_CRITICAL] = file;
+        overheadLine[OVERHEAD_CRITICAL] = line;
+        overheadStart[OVERHEAD_CRITICAL] = portOVERHEAD_COUNTER();
+    }
+}
+
+void vOverheadCriticalExit(void)
+{
+    if (--overheadCriticalNesting == 0)
+    {
+        overheadRecord(OVERHEAD_CRITICAL);
+    }
+}
+
+/* A task can yield inside a critical section, as ulTaskNotifyTake() does,
+and the section goes on when it runs again.  The time it is switched out is
+left out of the section, and the tasks that run meanwhile time their own.
+Both are called by vTaskSwitchContext() with interrupts disabled. */
+static void overheadSwitchOut(TCB_t *pxTCB)
+{
+    pxTCB->overheadNesting = overheadCriticalNesting;
+
+    if (overheadCriticalNesting > 0)
+    {
+        pxTCB->overheadElapsed = (uint32_t)portOVERHEAD_COUNTER() - overheadStart[OVERHEAD_CRITICAL];
+        pxTCB->overheadLine = overheadLine[OVERHEAD_CRITICAL];
+        pxTCB->overheadFile = overheadFile[OVERHEAD_CRITICAL];
+    }
+}
+
+static void overheadSwitchIn(const TCB_t *pxTCB)
+{
+    overheadCriticalNesting = pxTCB->overheadNesting;
+
+    if (overheadCriticalNesting > 0)
+    {
+        overheadStart[OVERHEAD_CRITICAL] = (uint32_t)portOVERHEAD_COUNTER() - pxTCB->overheadElapsed;
+        overheadLine[OVERHEAD_CRITICAL] = pxTCB->overheadLine;
+        overheadFile[OVERHEAD_CRITICAL] = pxTCB->overheadFile;
+    }
+}
+
+void vOverheadSuspendAll(char file, uint16_t line)
+{
+    (vTaskSuspendAll)();
+
+    /* Nothing else can suspend the scheduler until this task resumes it. */
+    if (uxSchedulerSuspended == (UBaseType_t)1)
+    {
+        portENTER_CRITICAL();
+        {
+            overheadFile[OVERHEAD_SUSPEND] = file;
+            overheadLine[OVERHEAD_SUSPEND] = line;
+            overheadStart[OVERHEAD_SUSPEND] = portOVERHEAD_COUNTER();
+        }
+        portEXIT_CRITICAL();
+    }
+}
+
+/* Called by the port with interrupts disabled, around the tick and the
+context switch it causes. */
+void vOverheadTickStart(void)
+{
+    overheadStart[OVERHEAD_TICK] = portOVERHEAD_COUNTER();
+}
+
+void vOverheadTickEnd(void)
+{
+    overheadRecord(OVERHEAD_TICK);
+}
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+/* Overhead profile, sent as one 'O' frame in reply to 'o':
+
+    flags, nanoseconds per count,
+    { maximum, bucket count, { count } per bucket } per kind
+        (critical section, scheduler suspension, tick interrupt),
+    site count, { file, kind, line, count, maximum } per site
+
+Numbers are varints and the rest single bytes, with the kind given as 'C' or
+'S'.  Sites that do not fit in one frame are left out and bit 0 of flags is
+set, as for the snapshot.  A payload byte of 1 clears the profile after it
+is sent. */
+#define OVERHEAD_TRUNCATED 0x01
+#define OVERHEAD_LENGTH_MAX 254
+#define OVERHEAD_SITE_LENGTH (2 + 4 * FRAME_VARINT_SIZE)
+
+static void overheadSend(void)
+{
+    uint8_t *profile;
+    uint8_t *end;
+    uint8_t *count;
+    uint8_t kind, i;
+
+    profile = (uint8_t *)pvPortMalloc(OVERHEAD_LENGTH_MAX);
+
+    if (profile == NULL)
+    {
+        sendNack('o', FRAME_NACK_NO_MEMORY);
+        return;
+    }
+
+    /* Taken in one piece, so the frame describes a single instant. */
+    portENTER_CRITICAL();
+    {
+        profile[0] = 0;
+        end = putVarint(&profile[1], (TickType_t)portOVERHEAD_NS_PER_COUNT);
+
+        for (kind = 0; kind < OVERHEAD_KINDS; kind++)
+        {
+            end = putVarint(end, (TickType_t)overheadMax[kind]);
+            *end++ = OVERHEAD_BUCKETS;
+
+            for (i = 0; i < OVERHEAD_BUCKETS; i++)
+            {
+                end = putVarint(end, overheadHistograms[kind][i]);
+            }
+        }
+        count = end++;
+        *count = 0;
+
+        for (i = 0; i < configOVERHEAD_SITES && overheadSites[i].count > 0; i++)
+        {
+            if (end + OVERHEAD_SITE_LENGTH > profile + OVERHEAD_LENGTH_MAX)
+            {
+                profile[0] |= OVERHEAD_TRUNCATED;
+                break;
+            }
+
+            *end++ = (uint8_t)overheadSites[i].file;
+            *end++ = (overheadSites[i].kind == OVERHEAD_CRITICAL) ? 'C' : 'S';
+            end = putVarint(end, overheadSites[i].line);
+            end = putVarint(end, overheadSites[i].count);
+            end = putVarint(end, (TickType_t)overheadSites[i].max);
+            (*count)++;
+        }
+    }
+    portEXIT_CRITICAL();
+
+    sendFrame('O', profile, end - profile);
+    vPortFree(profile);
+}
+
+#endif /* configUSE_FRAMED_COMMANDS */
+
+static void overheadClear(void)
+{
+    portENTER_CRITICAL();
+    {
+        memset(overheadSites, 0, sizeof(overheadSites));
+        memset(overheadHistograms, 0, sizeof(overheadHistograms));
+        memset(overheadMax, 0, sizeof(overheadMax));
+    }
+    portEXIT_CRITICAL();
+}
+
+/* Prints the maximum and histogram of each kind, then each call site with
+its count and maximum, in microseconds. */
+static void reportOverhead(void)
+{
+    static const char kindNames[OVERHEAD_KINDS] portFLASH = {'C', 'S', 'I'};
+    struct overheadSite site;
+    uint16_t histogram[OVERHEAD_BUCKETS];
+    portOVERHEAD_TYPE max;
+    char name[3] = {0, 0, 0};
+    uint8_t kind, i;
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        overheadSend();
+        return;
+    }
+#endif
+
+    for (kind = 0; kind < OVERHEAD_KINDS; kind++)
+    {
+        portENTER_CRITICAL();
+        {
+            memcpy(histogram, overheadHistograms[kind], sizeof(histogram));
+            max = overheadMax[kind];
+        }
+        portEXIT_CRITICAL();
+
+        name[0] = (char)portFLASH_READ_BYTE(&kindNames[kind]);
+        name[1] = 0;
+        print_literal("O:");
+        print_string(name);
+        print_literal(" ");
+        print_float((float)max * portOVERHEAD_NS_PER_COUNT / 1000);
+
+        for (i = 0; i < OVERHEAD_BUCKETS; i++)
+        {
+            print_literal((i == 0) ? " " : ",");
+            print_number(histogram[i]);
+        }
+        print_literal("\n");
+    }
+
+    for (i = 0; i < configOVERHEAD_SITES; i++)
+    {
+        portENTER_CRITICAL();
+        {
+            site = overheadSites[i];
+        }
+        portEXIT_CRITICAL();
+
+        if (site.count == 0)
+        {
+            break;
+        }
+
+        name[0] = site.file;
+        name[1] = (site.kind == OVERHEAD_CRITICAL) ? 'C' : 'S';
+        print_literal("O:");
+        print_string(name);
+        print_literal(" ");
+        print_number(site.line);
+        print_literal(" ");
+        print_number(site.count);
+        print_literal(" ");
+        print_float((float)site.max * portOVERHEAD_NS_PER_COUNT / 1000);
+        print_literal("\n");
+    }
+}
+
+#endif /* configUSE_OVERHEAD_PROFILER */
+
+void vTaskDeleteLogical()
+{
+#if (configGENERATE_RUN_TIME_STATS == 1)
+    recordJobRunTime(pxCurrentTCB);
+#endif
+    traceJOB_END(pxCurrentTCB);
+#if (configUSE_STACK_PROFILING == 1)
+    recordStackUsage(pxCurrentTCB);
+#endif
+#if (configUSE_TASK_RETIMING == 1)
+    taskENTER_CRITICAL();
+    {
+        if (pxCurrentTCB->retimePending != 0)
+        {
+            /* The new timing starts at the release the old timing would
+            have made next, delayed by the requested phase. */
+            pxCurrentTCB->arrival += (pxCurrentTCB->cycle + 1) * pxCurrentTCB->period + pxCurrentTCB->newPhase;
+            pxCurrentTCB->period = pxCurrentTCB->newPeriod;
+            pxCurrentTCB->duration = pxCurrentTCB->newDuration;
+            pxCurrentTCB->cycle = 0;
+            pxCurrentTCB->retimePending = 0;
+        }
+        else
+        {
+            pxCurrentTCB->cycle += 1;
+        }
+    }
+    taskEXIT_CRITICAL();
+#else
+    pxCurrentTCB->cycle += 1;
+#endif
+    restartTask = pxCurrentTCB;
+    portYIELD_WITHIN_API();
+}
+
+/* Job kernels.  A job runs for its duration in ticks; its kernel is called
+once at the start of each tick of execution, and the job spins for the rest
+of the tick.  Kernels are named by the letter used in 'p' and 'a' commands. */
+typedef void (*JobKernel_t)(const char *parameter, TickType_t counter);
+
+struct jobKernel
+{
+    char letter;
+    JobKernel_t kernel;
+};
+
+/* Loop iterations of burnLoops() that fill one tick, measured by the idle
+task.  Zero until the first measurement. */
+static volatile uint32_t burnLoopsPerTick = 0;
+static uint8_t burnCalibrations = 0;
+
+static uint8_t jobScratch[configJOB_SCRATCH_SIZE];
+static volatile uint8_t jobIoRegister;
+
+static void burnLoops(uint32_t loops)
+{
+    volatile uint32_t i;
+
+    for (i = 0; i < loops; i++)
+    {
+    }
+}
+
+/* Counts the loops of burnLoops() that fit between two tick interrupts.
+Called from the idle task, so keeps the largest of a few measurements in
+case a job preempted one of them. */
+static void jobCalibrate(void)
+{
+    volatile uint32_t loops = 0;
+    TickType_t start;
+
+    if (burnCalibrations >= 4)
+    {
+        return;
+    }
+
+    start = xTickCount;
+    while (start == xTickCount)
+    {
+        portSPIN_WAIT();
+    }
+
+    start = xTickCount;
+    while (start == xTickCount)
+    {
+        loops++;
+        portSPIN_WAIT();
+    }
+
+    if (loops > burnLoopsPerTick)
+    {
+        burnLoopsPerTick = loops;
+    }
+    burnCalibrations++;
+}
+
+/* Prints the parameter and the tick. */
+static void jobPrint(const char *parameter, TickType_t counter)
+{
+    jobOutput(parameter, counter);
+}
+
+/* Spends the given percentage of each tick in a calibrated busy loop. */
+static void jobBurn(const char *parameter, TickType_t counter)
+{
+    uint32_t percent = (uint32_t)atoi(parameter);
+
+    (void)counter;
+
+    if (percent > 100)
+    {
+        percent = 100;
+    }
+
+    burnLoops(burnLoopsPerTick / 100 * percent);
+}
+
+/* Reads and writes the given number of bytes of RAM each tick. */
+static void jobMemory(const char *parameter, TickType_t counter)
+{
+    uint16_t size = (uint16_t)atoi(parameter);
+    uint16_t i;
+
+    if (size > configJOB_SCRATCH_SIZE)
+    {
+        size = configJOB_SCRATCH_SIZE;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        jobScratch[i] = (uint8_t)(jobScratch[i] + counter);
+    }
+}
+
+/* Writes the given number of bytes each tick to a device register, waiting
+about a millisecond per byte as a blocking 9600 baud write would. */
+static void jobIo(const char *parameter, TickType_t counter)
+{
+    uint8_t bytes = (uint8_t)atoi(parameter);
+    uint8_t i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        jobIoRegister = (uint8_t)(counter + i);
+        burnLoops(burnLoopsPerTick / portTICK_PERIOD_MS);
+    }
+}
+
+static const struct jobKernel jobKernels[] portFLASH = {
+    {'w', jobPrint},
+    {'n', jobPrint},
+    {'c', jobBurn},
+    {'m', jobMemory},
+    {'i', jobIo},
+};
+
+#define JOB_KERNELS (sizeof(jobKernels) / sizeof(jobKernels[0]))
+
+/* Index of the kernel named by letter, or JOB_KERNELS if there is none. */
+static uint8_t jobKernelIndex(char letter)
+{
+    uint8_t i;
+
+    for (i = 0; i < JOB_KERNELS; i++)
+    {
+        if ((char)portFLASH_READ_BYTE(&(jobKernels[i].letter)) == letter)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#if (configUSE_STACK_PROFILING == 1) || (configUSE_STACK_PROFILE_SIZES == 1)
+
+/* Every job made by xTaskCreateJob() runs taskJob(), so those are profiled by
+their kernel, and other tasks by their function. */
+static portPOINTER_SIZE_TYPE stackProfileKey(TaskFunction_t taskCode, uint8_t kernel)
+{
+    struct jobKernel entry;
+
+    if (taskCode != taskJob)
+    {
+        return (portPOINTER_SIZE_TYPE)taskCode;
+    }
+
+    portFLASH_READ(&entry, &(jobKernels[kernel]), sizeof(entry));
+    return (portPOINTER_SIZE_TYPE)entry.kernel;
+}
+
+#endif
+
+#if (configUSE_APERIODIC_STATS == 1)
+
+/* Aperiodic job latency in log2 buckets: bucket 0 counts jobs that took no
+ticks, and bucket b those that took 2^(b-1) to 2^b - 1 ticks.  The wait is
+from arrival to the first tick of execution, and the response from arrival
+to the end of its last tick of execution.  Both are kept for the server as last configured. */
+#define LATENCY_BUCKETS (sizeof(TickType_t) * 8 + 1)
+
+struct latencyHistogram
+{
+    uint16_t count[LATENCY_BUCKETS];
+    TickType_t max;
+};
+
+static struct
+{
+    struct latencyHistogram wait;
+    struct latencyHistogram response;
+} aperiodicStats;
+
+/* Adds the latency of the running aperiodic job up to the given tick. */
+static void latencyRecord(struct latencyHistogram *histogram, TickType_t tick)
+{
+    TickType_t ticks = tick - pxCurrentTCB->arrival;
+    uint8_t bucket = 0;
+
+    taskENTER_CRITICAL();
+    {
+        if (ticks > histogram->max)
+        {
+            histogram->max = ticks;
+        }
+
+        while (ticks != 0)
+        {
+            ticks >>= 1;
+            bucket++;
+        }
+
+        if (histogram->count[bucket] < UINT16_MAX)
+        {
+            histogram->count[bucket]++;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Top of the bucket holding the given percentile, or the largest latency
+seen if that is smaller. */
+static TickType_t latencyPercentile(const struct latencyHistogram *histogram, uint8_t percent)
+{
+    uint32_t total = 0, seen = 0, rank;
+    uint8_t bucket;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+    {
+        total += histogram->count[bucket];
+    }
+
+    rank = (total * percent + 99) / 100;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS && total > 0; bucket++)
+    {
+        seen += histogram->count[bucket];
+
+        if (seen >= rank)
+        {
+            TickType_t top = (bucket == 0) ? 0 : (TickType_t)(((TickType_t)1 << (bucket - 1)) * 2 - 1);
+
+            return (top < histogram->max) ? top : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+static const uint8_t latencyPercents[] = {50, 95, 99};
+
+/* Reports completed aperiodic jobs, then p50, p95, p99 and the maximum of
+the wait and then of the response time. */
+static void reportAperiodicStats(void)
+{
+    TickType_t values[2 * (sizeof(latencyPercents) + 1)];
+    uint32_t completed = 0;
+    uint8_t i;
+
+    /* Jobs record their latency from task context only. */
+    vTaskSuspendAll();
+    {
+        for (i = 0; i < sizeof(latencyPercents); i++)
+        {
+            values[i] = latencyPercentile(&aperiodicStats.wait, latencyPercents[i]);
+            values[sizeof(latencyPercents) + 1 + i] = latencyPercentile(&aperiodicStats.response, latencyPercents[i]);
+        }
+        values[sizeof(latencyPercents)] = aperiodicStats.wait.max;
+        values[2 * sizeof(latencyPercents) + 1] = aperiodicStats.response.max;
+
+        for (i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            completed += aperiodicStats.response.count[i];
+        }
+    }
+    (void)xTaskResumeAll();
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        uint8_t payload[(1 + sizeof(values) / sizeof(values[0])) * FRAME_VARINT_SIZE];
+        uint8_t *end = putVarint(payload, (TickType_t)completed);
+
+        for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        {
+            end = putVarint(end, values[i]);
+        }
+
+        sendFrame('L', payload, end - payload);
+        return;
+    }
+#endif
+
+    print_literal("L:");
+    print_number(completed);
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        if (i == 0)
+        {
+            print_literal(" W:");
+        }
+        else if (i == sizeof(latencyPercents) + 1)
+        {
+            print_literal(" R:");
+        }
+        else
+        {
+            print_literal("/");
+        }
+        print_number(values[i]);
+    }
+    print_literal("\n");
+}
+
+#endif /* configUSE_APERIODIC_STATS */
+
+/* Runs one job of the current task with the given kernel, then ends it.
+Aperiodic jobs are charged to the server a tick at a time. */
+static void runJob(void *parameter, JobKernel_t kernel)
+{
+    const char *output = (const char *)parameter;
+    TickType_t counter = 0;
+    TickType_t temp = xTickCount - 1;
+    TickType_t duration = portJOB_EXECUTION_TICKS(pxCurrentTCB, pxCurrentTCB->duration);
+    BaseType_t aperiodic = (pxCurrentTCB->uxPriority == APERIODIC_TASK_PRIORITY);
+
+    while (counter < duration)
+    {
+        if (temp != xTickCount)
+        {
+            counter++;
+            if (counter == 1)
+            {
+                traceJOB_START(pxCurrentTCB, (aperiodic != pdFALSE) ? pxCurrentTCB->arrival : pxCurrentTCB->arrival + pxCurrentTCB->cycle * pxCurrentTCB->period);
+            }
+#if (configUSE_APERIODIC_STATS == 1)
+            if (aperiodic != pdFALSE && counter == 1)
+            {
+                latencyRecord(&aperiodicStats.wait, xTickCount);
+            }
+#endif
+            kernel(output, counter);
+            temp = xTickCount;
+
+            if (aperiodic != pdFALSE)
+            {
+                serverCapacity--;
+
+                if (serverCapacity == 0)
+                {
+                    traceSERVER_EXHAUSTED();
+                }
+            }
+        }
+        else
+        {
+            portSPIN_WAIT();
+        }
+    }
+
+#if (configUSE_APERIODIC_STATS == 1)
+    if (aperiodic != pdFALSE)
+    {
+        latencyRecord(&aperiodicStats.response, temp + 1);
+    }
+#endif
+
+    while (temp == xTickCount)
+    {
+        portSPIN_WAIT();
+    }
+
+    if (aperiodic == pdFALSE)
+    {
+        /* The deadline of a periodic job is its next release. */
+        TickType_t deadline = pxCurrentTCB->arrival + (pxCurrentTCB->cycle + 1) * pxCurrentTCB->period;
+
+        if ((TickType_t)(deadline - (temp + 1)) > pxCurrentTCB->period)
+        {
+            traceJOB_DEADLINE_MISS(pxCurrentTCB, deadline);
+        }
+        vTaskDeleteLogical();
+    }
+
+    traceJOB_END(pxCurrentTCB);
+#if (configUSE_STACK_PROFILING == 1)
+    recordStackUsage(pxCurrentTCB);
+#endif
+    vTaskDelete(NULL);
+}
+
+/* Job body for tasks made by xTaskCreateJob(). */
+void taskJob(void *parameter)
+{
+    struct jobKernel entry;
+
+    portFLASH_READ(&entry, &(jobKernels[pxCurrentTCB->jobKernel]), sizeof(entry));
+    runJob(parameter, entry.kernel);
+}
+
+void taskPeriodicNumber(void *parameter)
+{
+    runJob(parameter, jobPrint);
+}
+
+void taskPeriodic(void *parameter)
+{
+    runJob(parameter, jobPrint);
+}
+
+void taskAperiodicNumber(void *parameter)
+{
+    runJob(parameter, jobPrint);
+}
+
+void taskAperiodic(void *parameter)
+{
+    runJob(parameter, jobPrint);
+}
+
+void initialiseServer(TickType_t capacity, TickType_t period)
+{
+
+    serverCapacity = capacity;
+    serverPeriod = period;
+
+#if (configUSE_APERIODIC_STATS == 1)
+    /* Latency is kept per server configuration. */
+    vTaskSuspendAll();
+    {
+        memset(&aperiodicStats, 0, sizeof(aperiodicStats));
+    }
+    (void)xTaskResumeAll();
+#endif
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        uint8_t payload[2 * FRAME_VARINT_SIZE];
+        uint8_t *end = putVarint(putVarint(payload, serverCapacity), serverPeriod);
+
+        sendFrame('C', payload, end - payload);
+        return;
+    }
+#endif
+
+    print_literal("C:");
+    print_number(serverCapacity);
+    print_literal(" P:");
+    print_number(serverPeriod);
+    print_literal("\n");
+    return;
+}
+
+#if (INCLUDE_vTaskDelete == 1)
+
+/* Frees the name and parameter the command parser allocated for a deleted
+task, whether it was deleted by a command or ended by itself.  vTaskDelete()
+has already taken the task out of the registry, which hashes the name. */
+static void releaseJobStrings(TCB_t *pxTCB)
+{
+    if ((pxTCB->jobFlags & tskJOB_OWNS_STRINGS) != 0)
+    {
+        pxTCB->jobFlags &= (uint8_t)~tskJOB_OWNS_STRINGS;
+        vPortFree(pxTCB->pcName);
+        vPortFree(pxTCB->pvParameters);
+    }
+}
+
+#endif /* INCLUDE_vTaskDelete */
+
+#if (configUSE_TASK_RECYCLING == 1)
+
+static void recordReclaimLatency(TCB_t *pxTCB)
+{
+    /* The item value was set to the tick the task deleted itself at. */
+    xReclaimLatencyLast = xTickCount - listGET_LIST_ITEM_VALUE(&(pxTCB->xStateListItem));
+
+    if (xReclaimLatencyLast > xReclaimLatencyMax)
+    {
+        xReclaimLatencyMax = xReclaimLatencyLast;
+    }
+}
+
+static TCB_t *findRecyclable(List_t *pxList, configSTACK_DEPTH_TYPE stackDepth)
+{
+    const ListItem_t *item;
+    TCB_t *temp;
+
+    for (item = listGET_HEAD_ENTRY(pxList); item != listGET_END_MARKER(pxList); item = listGET_NEXT(item))
+    {
+        temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
+
+        if (temp != pxCurrentTCB && temp->recyclable != pdFALSE && temp->stackDepth >= stackDepth)
+        {
+            return temp;
+        }
+    }
+
+    return NULL;
+}
+
+/* Takes a deleted TCB whose stack holds at least stackDepth words, from the
+cache or straight from the termination list before the idle task gets to it. */
+static TCB_t *takeRecycledTCB(configSTACK_DEPTH_TYPE stackDepth)
+{
+    TCB_t *pxTCB;
+
+    /* The lists are initialised when the first task is added to them. */
+    if (uxCurrentNumberOfTasks == (UBaseType_t)0U)
+    {
+        return NULL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        pxTCB = findRecyclable(&xRecycledTasks, stackDepth);
+
+        if (pxTCB == NULL)
+        {
+            pxTCB = findRecyclable(&xTasksWaitingTermination, stackDepth);
+
+            if (pxTCB != NULL)
+            {
+                recordReclaimLatency(pxTCB);
+                --uxCurrentNumberOfTasks;
+                --uxDeletedTasksWaitingCleanUp;
+            }
+        }
+
+        if (pxTCB != NULL)
+        {
+            (void)uxListRemove(&(pxTCB->xStateListItem));
+            uxTasksRecycled++;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    /* A TCB taken straight from the termination list still holds its
+    strings. */
+    if (pxTCB != NULL)
+    {
+        releaseJobStrings(pxTCB);
+    }
+
+    return pxTCB;
+}
+
+/* Keeps a deleted task for reuse if there is room, else frees it. */
+static void reclaimTCB(TCB_t *pxTCB)
+{
+    BaseType_t cached = pdFALSE;
+
+    releaseJobStrings(pxTCB);
+
+    if (pxTCB->recyclable != pdFALSE)
+    {
+        taskENTER_CRITICAL();
+        {
+            if (listCURRENT_LIST_LENGTH(&xRecycledTasks) < (UBaseType_t)configTASK_RECYCLE_CACHE_SIZE)
+            {
+                vListInsertEnd(&xRecycledTasks, &(pxTCB->xStateListItem));
+                cached = pdTRUE;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    if (cached == pdFALSE)
+    {
+        prvDeleteTCB(pxTCB);
+    }
+}
+
+void vTaskGetReclaimStats(TickType_t *pxLatencyMax, TickType_t *pxLatencyLast, UBaseType_t *puxRecycled)
+{
+    taskENTER_CRITICAL();
+    {
+        *pxLatencyMax = xReclaimLatencyMax;
+        *pxLatencyLast = xReclaimLatencyLast;
+        *puxRecycled = uxTasksRecycled;
+    }
+    taskEXIT_CRITICAL();
+}
+
+#endif /* configUSE_TASK_RECYCLING */
+
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+
+BaseType_t xTaskCreatePeriodic(TaskFunction_t pxTaskCode,
+                               const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
+                               const configSTACK_DEPTH_TYPE usStackDepth,
+                               void *const pvParameters,
+                               UBaseType_t uxPriority,
+                               TaskHandle_t *const pxCreatedTask, TickType_t arrival, TickType_t period, TickType_t duration)
+{
+    TCB_t *pxNewTCB;
+    BaseType_t xReturn;
+
+    StackType_t *pxStack;
+
+    configSTACK_DEPTH_TYPE stackDepth = usStackDepth;
+
+#if (configUSE_STACK_PROFILE_SIZES == 1)
+    /* Jobs of xTaskCreateJob() arrive with the size learned for their kernel. */
+    if (pxTaskCode != taskJob)
+    {
+        stackDepth = learnedStackDepth(stackProfileKey(pxTaskCode, 0), usStackDepth);
+    }
+#endif
+
+#if (configUSE_SHARED_JOB_STACK == 1)
+    if (uxPriority == PERIODIC_TASK_PRIORITY && period > 0)
+    {
+        /* Periodic jobs get a frame on the shared stack when dispatched. */
+        pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t));
+
+        if (pxNewTCB != NULL)
+        {
+            if (sharedJobStackFilled == pdFALSE)
+            {
+                (void)memset(sharedJobStack, (int)tskSTACK_FILL_BYTE, sizeof(sharedJobStack));
+                sharedJobStackFilled = pdTRUE;
+            }
+
+            pxNewTCB->pxStack = sharedJobStack;
+            pxNewTCB->pxSharedPrev = NULL;
+            pxNewTCB->jobStarted = 0;
+            prvInitialiseNewTask(pxTaskCode, pcName, configSHARED_JOB_STACK_SIZE, pvParameters, uxPriority, pxCreatedTask, pxNewTCB, NULL);
+            pxNewTCB->arrival = arrival;
+            pxNewTCB->duration = duration;
+            pxNewTCB->period = period;
+            pxNewTCB->cycle = 0;
+#if (configUSE_TASK_RETIMING == 1)
+            pxNewTCB->retimePending = 0;
+#endif
+            pxNewTCB->pvParameters = pvParameters;
+            pxNewTCB->stackDepth = configSHARED_JOB_STACK_SIZE;
+            pxNewTCB->taskCode = pxTaskCode;
+            pxNewTCB->pcName = pcName;
+            prvAddNewTaskToReadyList(pxNewTCB);
+            return pdPASS;
+        }
+
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+#endif /* configUSE_SHARED_JOB_STACK */
+
+#if (configUSE_TASK_RECYCLING == 1)
+    /* Reuse a deleted task's TCB and stack, skipping the heap. */
+    pxNewTCB = takeRecycledTCB(stackDepth);
+
+    if (pxNewTCB != NULL)
+    {
+        stackDepth = pxNewTCB->stackDepth;
+    }
+    else
+#endif
+    {
+        /* Allocate space for the stack used by the task being created. */
+        pxStack = (StackType_t *)pvPortMalloc((((size_t)stackDepth) * sizeof(StackType_t)));
+
+        if (pxStack != NULL)
+        {
+            /* Allocate space for the TCB. */
+            pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t));
+
+            if (pxNewTCB != NULL)
+            {
+                /* Store the stack location in the TCB. */
+                pxNewTCB->pxStack = pxStack;
+            }
+            else
+            {
+                /* The stack cannot be used as the TCB was not created.  Free
+                            it again. */
+                vPortFree(pxStack);
+            }
+        }
+        else
+        {
+            pxNewTCB = NULL;
+        }
+    }
+
+    if (pxNewTCB != NULL)
+    {
+#if (configUSE_SHARED_JOB_STACK == 1)
+        pxNewTCB->pxSharedPrev = NULL;
+        pxNewTCB->jobStarted = 0;
+#endif
+        prvInitialiseNewTask(pxTaskCode, pcName, stackDepth, pvParameters, uxPriority, pxCreatedTask, pxNewTCB, NULL);
+        pxNewTCB->arrival = arrival;
+        pxNewTCB->duration = duration;
+        pxNewTCB->period = period;
+        pxNewTCB->cycle = 0;
+#if (configUSE_TASK_RETIMING == 1)
+        pxNewTCB->retimePending = 0;
+#endif
+        pxNewTCB->pvParameters = pvParameters;
+        pxNewTCB->stackDepth = stackDepth;
+        pxNewTCB->taskCode = pxTaskCode;
+        pxNewTCB->pcName = pcName;
+#if (configUSE_TASK_RECYCLING == 1)
+        pxNewTCB->recyclable = pdTRUE;
+#endif
+        prvAddNewTaskToReadyList(pxNewTCB);
+        xReturn = pdPASS;
+    }
+    else
+    {
+        xReturn = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    return xReturn;
+}
+
+static const configSTACK_DEPTH_TYPE stackClassDepth[] portFLASH = {64, 100, 160};
+
+BaseType_t xTaskCreateFromDescriptor(const TaskDescriptor_t *pxDescriptors, UBaseType_t uxIndex, TaskHandle_t *const pxCreatedTask)
+{
+    TaskDescriptor_t descriptor;
+    configSTACK_DEPTH_TYPE stackDepth;
+    char name[configMAX_TASK_NAME_LEN];
+    TaskHandle_t handle;
+    BaseType_t xReturn;
+    uint8_t i;
+
+    portFLASH_READ(&descriptor, &(pxDescriptors[uxIndex]), sizeof(descriptor));
+    portFLASH_READ(&stackDepth, &(stackClassDepth[descriptor.stackClass]), sizeof(stackDepth));
+
+    for (i = 0; i < configMAX_TASK_NAME_LEN - 1; i++)
+    {
+        name[i] = (char)portFLASH_READ_BYTE(descriptor.pcName + i);
+
+        if (name[i] == 0)
+        {
+            break;
+        }
+    }
+    name[i] = 0;
+
+    xReturn = xTaskCreatePeriodic(descriptor.pxTaskCode, name, stackDepth, descriptor.pvParameters, descriptor.uxPriority, &handle,
+                                  xTaskGetTickCount() + descriptor.arrival, descriptor.period, descriptor.duration);
+
+    if (xReturn == pdPASS)
+    {
+        /* The name buffer is on this stack, so point at the TCB's copy. */
+        ((TCB_t *)handle)->pcName = ((TCB_t *)handle)->pcTaskName;
+
+        if (pxCreatedTask != NULL)
+        {
+            *pxCreatedTask = handle;
+        }
+    }
+
+    return xReturn;
+}
+
+/* Creates a task whose jobs run the kernel named by letter, such as 'c' for
+a CPU burn.  Fails if there is no such kernel. */
+BaseType_t xTaskCreateJob(char kernel,
+                          const char *const pcName,
+                          void *const pvParameters,
+                          UBaseType_t uxPriority,
+                          TaskHandle_t *const pxCreatedTask, TickType_t arrival, TickType_t period, TickType_t duration)
+{
+    uint8_t index = jobKernelIndex(kernel);
+    configSTACK_DEPTH_TYPE stackDepth = 100;
+    TaskHandle_t handle;
+    BaseType_t xReturn;
+
+    if (index >= JOB_KERNELS)
+    {
+        return pdFAIL;
+    }
+
+#if (configUSE_STACK_PROFILE_SIZES == 1)
+    stackDepth = learnedStackDepth(stackProfileKey(taskJob, index), stackDepth);
+#endif
+
+    /* The first job must not start before it knows its kernel. */
+    vTaskSuspendAll();
+    {
+        xReturn = xTaskCreatePeriodic(taskJob, pcName, stackDepth, pvParameters, uxPriority, &handle, arrival, period, duration);
+
+        if (xReturn == pdPASS)
+        {
+            ((TCB_t *)handle)->jobKernel = index;
+
+            if (pxCreatedTask != NULL)
+            {
+                *pxCreatedTask = handle;
+            }
+        }
+    }
+    (void)xTaskResumeAll();
+
+    return xReturn;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode,
+                       const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
+                       const configSTACK_DEPTH_TYPE usStackDepth,
+                       void *const pvParameters,
+                       UBaseType_t uxPriority,
+                       TaskHandle_t *const pxCreatedTask)
+{
+    TCB_t *pxNewTCB;
+    BaseType_t xReturn;
+
+/* If the stack grows down then allocate the stack then the TCB so the stack
+        does not grow into the TCB.  Likewise if the stack grows up then allocate
+        the TCB then the stack. */
+#if (portSTACK_GROWTH > 0)
+    {
+        /* Allocate space for the TCB.  Where the memory comes from depends on
+            the implementation of the port malloc function and whether or not static
+            allocation is being used. */
+        pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t));
+
+        if (pxNewTCB != NULL)
+        {
+            /* Allocate space for the stack used by the task being created.
+                The base of the stack memory stored in the TCB so the task can
+                be deleted later if required. */
+            pxNewTCB->pxStack = (StackType_t *)pvPortMalloc((((size_t)usStackDepth) * sizeof(StackType_t))); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+
+            if (pxNewTCB->pxStack == NULL)
+            {
+                /* Could not allocate the stack.  Delete the allocated TCB. */
+                vPortFree(pxNewTCB);
+                pxNewTCB = NULL;
+            }
+        }
+    }
+#else  /* portSTACK_GROWTH */
+    {
+        StackType_t *pxStack;
+
+        /* Allocate space for the stack used by the task being created. */
+        pxStack = (StackType_t *)pvPortMalloc((((size_t)usStackDepth) * sizeof(StackType_t))); /*lint !e9079 All values returned by pvPortMalloc() have at least the alignment required by the MCU's stack and this allocation is the stack. */
+
+        if (pxStack != NULL)
+        {
+            /* Allocate space for the TCB. */
+            pxNewTCB = (TCB_t *)pvPortMalloc(sizeof(TCB_t)); /*lint !e9087 !e9079 All values returned by pvPortMalloc() have at least the alignment required by the MCU's stack, and the first member of TCB_t is always a pointer to the task's stack. */
+
+            if (pxNewTCB != NULL)
+            {
+                /* Store the stack location in the TCB. */
+                pxNewTCB->pxStack = pxStack;
+            }
+            else
+            {
+                /* The stack cannot be used as the TCB was not created.  Free
+                    it again. */
+                vPortFree(pxStack);
+            }
+        }
+        else
+        {
+            pxNewTCB = NULL;
+        }
+    }
+#endif /* portSTACK_GROWTH */
+
+    if (pxNewTCB != NULL)
+    {
+#if (tskSTATIC_AND_DYNAMIC_ALLOCATION_POSSIBLE != 0) /*lint !e9029 !e731 Macro has been consolidated for readability reasons. */
+        {
+            /* Tasks can be created statically or dynamically, so note this
+                task was created dynamically in case it is later deleted. */
+            pxNewTCB->ucStaticallyAllocated = tskDYNAMICALLY_ALLOCATED_STACK_AND_TCB;
+        }
+#endif /* tskSTATIC_AND_DYNAMIC_ALLOCATION_POSSIBLE */
+
+        prvInitialiseNewTask(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, pxNewTCB, NULL);
+        prvAddNewTaskToReadyList(pxNewTCB);
+        xReturn = pdPASS;
+    }
+    else
+    {
+        xReturn = errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    return xReturn;
+}
+
+#endif /* configSUPPORT_DYNAMIC_ALLOCATION */
+/*-----------------------------------------------------------*/
+
+static void prvInitialiseNewTask(TaskFunction_t pxTaskCode,
+                                 const char *const pcName, /*lint !e971 Unqualified char types are allowed for strings and single characters only. */
+                                 const configSTACK_DEPTH_TYPE ulStackDepth,
+                                 void *const pvParameters,
+                                 UBaseType_t uxPriority,
+                                 TaskHandle_t *const pxCreatedTask,
+                                 TCB_t *pxNewTCB,
+                                 const MemoryRegion_t *const xRegions)
+{
+    StackType_t *pxTopOfStack;
+    UBaseType_t x;
+
+#if (portUSING_MPU_WRAPPERS == 1)
+    /* Should the task be created in privileged mode? */
+    BaseType_t xRunPrivileged;
+    if ((uxPriority & portPRIVILEGE_BIT) != 0U)
+    {
+        xRunPrivileged = pdTRUE;
+    }
+    else
+    {
+        xRunPrivileged = pdFALSE;
+    }
+    uxPriority &= ~portPRIVILEGE_BIT;
+#endif /* portUSING_MPU_WRAPPERS == 1 */
+
+/* Avoid dependency on memset() if it is not required. */
+#if (tskSET_NEW_STACKS_TO_KNOWN_VALUE == 1)
+    /* A shared job stack may hold live frames of other jobs. */
+    if (tskSTACK_IS_SHARED(pxNewTCB) == pdFALSE)
+    {
+        /* Fill the stack with a known value to assist debugging. */
+        (void)memset(pxNewTCB->pxStack, (int)tskSTACK_FILL_BYTE, (size_t)ulStackDepth * sizeof(StackType_t));
+    }
+#endif /* tskSET_NEW_STACKS_TO_KNOWN_VALUE */
+
+/* Calculate the top of stack address.  This depends on whether the stack
+    grows from high memory to low (as per the 80x86) or vice versa.
+    portSTACK_GROWTH is used to make the result positive or negative as required
+    by the port. */
+#if (portSTACK_GROWTH < 0)
+    {
+        pxTopOfStack = &(pxNewTCB->pxStack[ulStackDepth - (configSTACK_DEPTH_TYPE)1]);
+        pxTopOfStack = (StackType_t *)(((portPOINTER_SIZE_TYPE)pxTopOfStack) & (~((portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK))); /*lint !e923 !e9033 !e9078 MISRA exception.  Avoiding casts between pointers and integers is not practical.  Size differences accounted for using portPOINTER_SIZE_TYPE type.  Checked by assert(). */
+
+        /* Check the alignment of the calculated top of stack is correct. */
+        configASSERT((((portPOINTER_SIZE_TYPE)pxTopOfStack & (portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK) == 0UL));
+
+#if (configRECORD_STACK_HIGH_ADDRESS == 1)
+        {
+            /* Also record the stack's high address, which may assist
+            debugging. */
+            pxNewTCB->pxEndOfStack = pxTopOfStack;
+        }
+#endif /* configRECORD_STACK_HIGH_ADDRESS */
+    }
+#else  /* portSTACK_GROWTH */
+    {
+        pxTopOfStack = pxNewTCB->pxStack;
+
+        /* Check the alignment of the stack buffer is correct. */
+        configASSERT((((portPOINTER_SIZE_TYPE)pxNewTCB->pxStack & (portPOINTER_SIZE_TYPE)portBYTE_ALIGNMENT_MASK) == 0UL));
+
+        /* The other extreme of the stack space is required if stack checking is
+        performed. */
+        pxNewTCB->pxEndOfStack = pxNewTCB->pxStack + (ulStackDepth - (configSTACK_DEPTH_TYPE)1);
+    }
+#endif /* portSTACK_GROWTH */
+
+    /* Store the task name in the TCB. */
+    if (pcName != NULL)
+    {
+        for (x = (UBaseType_t)0; x < (UBaseType_t)configMAX_TASK_NAME_LEN; x++)
+        {
+            pxNewTCB->pcTaskName[x] = pcName[x];
+
+            /* Don't copy all configMAX_TASK_NAME_LEN if the string is shorter than
+        configMAX_TASK_NAME_LEN characters just in case the memory after the
+        string is not accessible (extremely unlikely). */
+            if (pcName[x] == (char)0x00)
+            {
+                break;
+            }
+            else
+            {
+                mtCOVERAGE_TEST_MARKER();
+            }
+        }
+
+        /* Ensure the name string is terminated in the case that the string length
+    was greater or equal to configMAX_TASK_NAME_LEN. */
+        pxNewTCB->pcTaskName[configMAX_TASK_NAME_LEN - 1] = '\0';
+    }
+    else
+    {
+        /* The task has not been given a name, so just ensure there is a NULL
+        terminator when it is read out. */
+        pxNewTCB->pcTaskName[0] = 0x00;
+    }
+
+    /* xTaskCreatePeriodic() points this at the caller's string instead. */
+    pxNewTCB->pcName = pxNewTCB->pcTaskName;
+    pxNewTCB->jobKernel = 0;
+    pxNewTCB->jobFlags = 0;
+
+    /* This is used as an array index so must ensure it's not too large.  First
+    remove the privilege bit if one is present. */
+    if (uxPriority >= (UBaseType_t)configMAX_PRIORITIES)
+    {
+        uxPriority = (UBaseType_t)configMAX_PRIORITIES - (UBaseType_t)1U;
+    }
+    else
+    {
+        mtCOVERAGE_TEST_MARKER();
+    }
+
+    pxNewTCB->uxPriority = uxPriority;
+#if (configUSE_TASK_RECYCLING == 1)
+    {
+        pxNewTCB->recyclable = pdFALSE;
+    }
+#endif /* configUSE_TASK_RECYCLING */
+#if (configUSE_OVERHEAD_PROFILER == 1)
+    {
+        pxNewTCB->overheadNesting = 0;
+    }
+#endif /* configUSE_OVERHEAD_PROFILER */
+#if (configUSE_MUTEXES == 1)
+    {
+        pxNewTCB->uxBasePriority = uxPriority;
+        pxNewTCB->uxMutexesHeld = 0;
+    }
+#endif /* configUSE_MUTEXES */
+
+    vListInitialiseItem(&(pxNewTCB->xStateListItem));
+    vListInitialiseItem(&(pxNewTCB->xEventListItem));
+
+    /* Set the pxNewTCB as a link back from the ListItem_t.  This is so we can get
+    back to    the containing TCB from a generic item in a list. */
+    listSET_LIST_ITEM_OWNER(&(pxNewTCB->xStateListItem), pxNewTCB);
+
+    /* Event lists are always in priority order. */
+    listSET_LIST_ITEM_VALUE(&(pxNewTCB->xEventListItem), (TickType_t)configMAX_PRIORITIES - (TickType_t)uxPriority); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+    listSET_LIST_ITEM_OWNER(&(pxNewTCB->xEventListItem), pxNewTCB);
+
+#if (portCRITICAL_NESTING_IN_TCB == 1)
+    {
+        pxNewTCB->uxCriticalNesting = (UBaseType_t)0U;
+    }
+#endif /* portCRITICAL_NESTING_IN_TCB */
+
+#if (configUSE_APPLICATION_TASK_TAG == 1)
+    {
+        pxNewTCB->pxTaskTag = NULL;
+    }
+#endif /* configUSE_APPLICATION_TASK_TAG */
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+    {
+        pxNewTCB->ulRunTimeCounter = 0UL;
+        pxNewTCB->ulJobStartRunTime = 0UL;
+        pxNewTCB->ulMaxJobRunTime = 0UL;
+        pxNewTCB->usOverruns = 0;
+    }
+#endif /* configGENERATE_RUN_TIME_STATS */
+
+#if (portUSING_MPU_WRAPPERS == 1)
+    {
+        vPortStoreTaskMPUSettings(&(pxNewTCB->xMPUSettings), xRegions, pxNewTCB->pxStack, ulStackDepth);
+    }
+#else
+    {
+        /* Avoid compiler warning about unreferenced parameter. */
+        (void)xRegions;
+    }
+#endif
+
+#if (configNUM_THREAD_LOCAL_STORAGE_POINTERS != 0)
+    {
+        for (x = 0; x < (UBaseType_t)configNUM_THREAD_LOCAL_STORAGE_POINTERS; x++)
+        {
+            pxNewTCB->pvThreadLocalStoragePointers[x] = NULL;
+        }
+    }
+#endif
+
+#if (configUSE_TASK_NOTIFICATIONS == 1)
+    {
+        pxNewTCB->ulNotifiedValue = 0;
+        pxNewTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+    }
+#endif
+
+#if (configUSE_NEWLIB_REENTRANT == 1)
+    {
+        /* Initialise this task's Newlib reent structure. */
+        _REENT_INIT_PTR((&(pxNewTCB->xNewLib_reent)));
+    }
+#endif
+
+#if (INCLUDE_xTaskAbortDelay == 1)
+    {
+        pxNewTCB->ucDelayAborted = pdFALSE;
+    }
+#endif
+
+/* Initialize the TCB stack to look as if the task was already running,
+    but had been interrupted by the scheduler.  The return address is set
+    to the start of the task function. Once the stack has been initialised
+    the top of stack variable is updated.  Jobs on the shared stack are
+    initialised when they are first dispatched instead. */
+    if (tskSTACK_IS_SHARED(pxNewTCB) == pdFALSE)
+#if (portUSING_MPU_WRAPPERS == 1)
+    {
+/* If the port has capability to detect stack overflow,
+        pass the stack end address to the stack initialization
+        function as well. */
+#if (portHAS_STACK_OVERFLOW_CHECKING == 1)
+        {
+#if (portSTACK_GROWTH < 0)
+            {
+                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxStack, pxTaskCode, pvParameters, xRunPrivileged);
+            }
+#else  /* portSTACK_GROWTH */
+            {
+                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxEndOfStack, pxTaskCode, pvParameters, xRunPrivileged);
+            }
+#endif /* portSTACK_GROWTH */
+        }
+#else  /* portHAS_STACK_OVERFLOW_CHECKING */
+        {
+            pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxTaskCode, pvParameters, xRunPrivileged);
+        }
+#endif /* portHAS_STACK_OVERFLOW_CHECKING */
+    }
+#else /* portUSING_MPU_WRAPPERS */
+    {
+/* If the port has capability to detect stack overflow,
+        pass the stack end address to the stack initialization
+        function as well. */
+#if (portHAS_STACK_OVERFLOW_CHECKING == 1)
+        {
+#if (portSTACK_GROWTH < 0)
+            {
+                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxStack, pxTaskCode, pvParameters);
+            }
+#else  /* portSTACK_GROWTH */
+            {
+                pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxNewTCB->pxEndOfStack, pxTaskCode, pvParameters);
+            }
+#endif /* portSTACK_GROWTH */
+        }
+#else  /* portHAS_STACK_OVERFLOW_CHECKING */
+        {
+            pxNewTCB->pxTopOfStack = pxPortInitialiseStack(pxTopOfStack, pxTaskCode, pvParameters);
+        }
+#endif /* portHAS_STACK_OVERFLOW_CHECKING */
+    }
+#endif /* portUSING_MPU_WRAPPERS */
+
+    if (pxCreatedTask != NULL)
+    {
+        /* Pass the handle out in an anonymous way.  The handle can be used to
+        change the created task's priority, delete the created task, etc.*/
+        *pxCreatedTask = (TaskHandle_t)pxNewTCB;
+    }
+    else
+    {
+        mtCOVERAGE_TEST_MARKER();
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvAddNewTaskToReadyList(TCB_t *pxNewTCB)
+{
+    /* Ensure interrupts don't access the task lists while the lists are being
+    updated. */
+    taskENTER_CRITICAL();
+    {
+        uxCurrentNumberOfTasks++;
+        if (pxCurrentTCB == NULL)
+        {
+            /* There are no other tasks, or all the other tasks are in
+            the suspended state - make this the current task. */
+            pxCurrentTCB = pxNewTCB;
+
+            if (uxCurrentNumberOfTasks == (UBaseType_t)1)
+            {
+                /* This is the first task to be created so do the preliminary
+                initialisation required.  We will not recover if this call
+                fails, but we will report the failure. */
+                prvInitialiseTaskLists();
+            }
+            else
+            {
+                mtCOVERAGE_TEST_MARKER();
+            }
+        }
+        else
+        {
+            /* If the scheduler is not already running, make this task the
+            current task if it is the highest priority task to be created
+            so far. */
+            if (xSchedulerRunning == pdFALSE)
+            {
+                if (pxCurrentTCB->uxPriority <= pxNewTCB->uxPriority)
+                {
+                    pxCurrentTCB = pxNewTCB;
+                }
+                else
+                {
                     mtCOVERAGE_TEST_MARKER();
                 }
             }
-            else
+            else
+            {
+                mtCOVERAGE_TEST_MARKER();
+            }
+        }
+
+        uxTaskNumber++;
+
+#if (configUSE_TRACE_FACILITY == 1)
+        {
+            /* Add a counter into the TCB for tracing only. */
+            pxNewTCB->uxTCBNumber = uxTaskNumber;
+        }
+#endif /* configUSE_TRACE_FACILITY */
+        registryAdd(pxNewTCB);
+        traceTASK_CREATE(pxNewTCB);
+
+        prvAddTaskToReadyList(pxNewTCB);
+
+        portSETUP_TCB(pxNewTCB);
+    }
+    taskEXIT_CRITICAL();
+
+    if (xSchedulerRunning != pdFALSE)
+    {
+        /* If the created task is of a higher priority than the current task
+        then it should run now. */
+        if (pxCurrentTCB->uxPriority < pxNewTCB->uxPriority)
+        {
+            taskYIELD_IF_USING_PREEMPTION();
+        }
+        else
+        {
+            mtCOVERAGE_TEST_MARKER();
+        }
+    }
+    else
+    {
+        mtCOVERAGE_TEST_MARKER();
+    }
+}
+/*-----------------------------------------------------------*/
+
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+
+static BaseType_t createTaskCommand(char type, const char *name, char function, const char *param, TickType_t arrival, TickType_t period, TickType_t duration, TaskHandle_t *handle);
+
+#define TASK_SET_MAGIC 0xA7
+#define TASK_SET_VERSION 2
+
+/* Task set snapshot layout in EEPROM: a header, count records, then a
+CRC-16 over both.  Job bodies are stored by kernel letter so the snapshot
+stays valid when the firmware is rebuilt. */
+struct taskSetHeader
+{
+    uint8_t magic;
+    uint8_t version;
+    uint8_t count;
+    TickType_t serverCapacity;
+    TickType_t serverPeriod;
+};
+
+struct taskSetRecord
+{
+    char kernel;
+    char name[MAX_TASK_NAME_LENGTH + 1];
+    char param[MAX_TASK_NAME_LENGTH + 1];
+    TickType_t offset;
+    TickType_t period;
+    TickType_t duration;
+};
+
+#define TASK_SET_RECORD_ADDRESS(i) (configTASK_SET_EEPROM_ADDRESS + sizeof(struct taskSetHeader) + (i) * sizeof(struct taskSetRecord))
+
+/* Letter of the job kernel a task runs, or 0 if it is not a job task. */
+static char snapshotKernel(const TCB_t *pxTCB)
+{
+    if (pxTCB->taskCode == taskJob)
+    {
+        return (char)portFLASH_READ_BYTE(&(jobKernels[pxTCB->jobKernel].letter));
+    }
+
+    if (pxTCB->taskCode == taskPeriodic)
+    {
+        return 'w';
+    }
+
+    if (pxTCB->taskCode == taskPeriodicNumber)
+    {
+        return 'n';
+    }
+
+    return 0;
+}
+
+/* Writes the periodic tasks and server parameters to EEPROM.  Only bytes
+that changed are written. */
+void saveTaskSet(void)
+{
+    TCB_t *tasks[configTASK_SET_SNAPSHOT_ENTRIES];
+    struct taskSetHeader header;
+    struct taskSetRecord record;
+    const ListItem_t *item;
+    TickType_t base = portMAX_DELAY;
+    uint16_t crc;
+    uint8_t count = 0;
+    uint8_t i;
+
+    /* The task list must not change while it is walked. */
+    vTaskSuspendAll();
+    {
+        for (item = listGET_HEAD_ENTRY(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+             item != listGET_END_MARKER(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])) && count < configTASK_SET_SNAPSHOT_ENTRIES;
+             item = listGET_NEXT(item))
+        {
+            TCB_t *temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
+
+            if (temp->period > 0 && snapshotKernel(temp) != 0)
+            {
+                tasks[count++] = temp;
+
+                if (temp->arrival < base)
+                {
+                    base = temp->arrival;
+                }
+            }
+        }
+
+        header.magic = TASK_SET_MAGIC;
+        header.version = TASK_SET_VERSION;
+        header.count = count;
+        header.serverCapacity = serverCapacity;
+        header.serverPeriod = serverPeriod;
+    }
+    (void)xTaskResumeAll();
+
+    crc = crc16Block(0xFFFF, &header, sizeof(header));
+    portEEPROM_WRITE(&header, configTASK_SET_EEPROM_ADDRESS, sizeof(header));
+
+    for (i = 0; i < count; i++)
+    {
+        memset(&record, 0, sizeof(record));
+        record.kernel = snapshotKernel(tasks[i]);
+        strncpy(record.name, tasks[i]->pcName, MAX_TASK_NAME_LENGTH);
+        strncpy(record.param, (char *)tasks[i]->pvParameters, MAX_TASK_NAME_LENGTH);
+        record.offset = tasks[i]->arrival - base;
+        record.period = tasks[i]->period;
+        record.duration = tasks[i]->duration;
+
+        crc = crc16Block(crc, &record, sizeof(record));
+        portEEPROM_WRITE(&record, TASK_SET_RECORD_ADDRESS(i), sizeof(record));
+    }
+
+    portEEPROM_WRITE(&crc, TASK_SET_RECORD_ADDRESS(count), sizeof(crc));
+}
+
+/* Recreates the task set saved by saveTaskSet().  Nothing is created unless
+the whole snapshot is intact.  Returns pdTRUE if a task set was restored. */
+BaseType_t restoreTaskSet(void)
+{
+    struct taskSetHeader header;
+    struct taskSetRecord record;
+    uint16_t crc, savedCrc;
+    TickType_t now = xTaskGetTickCount();
+    uint8_t i;
+
+    portEEPROM_READ(&header, configTASK_SET_EEPROM_ADDRESS, sizeof(header));
+
+    if (header.magic != TASK_SET_MAGIC || header.version != TASK_SET_VERSION || header.count > configTASK_SET_SNAPSHOT_ENTRIES)
+    {
+        return pdFALSE;
+    }
+
+    crc = crc16Block(0xFFFF, &header, sizeof(header));
+
+    for (i = 0; i < header.count; i++)
+    {
+        portEEPROM_READ(&record, TASK_SET_RECORD_ADDRESS(i), sizeof(record));
+
+        if (jobKernelIndex(record.kernel) >= JOB_KERNELS)
+        {
+            return pdFALSE;
+        }
+
+        crc = crc16Block(crc, &record, sizeof(record));
+    }
+
+    portEEPROM_READ(&savedCrc, TASK_SET_RECORD_ADDRESS(header.count), sizeof(savedCrc));
+
+    if (crc != savedCrc)
+    {
+        return pdFALSE;
+    }
+
+    serverCapacity = header.serverCapacity;
+    serverPeriod = header.serverPeriod;
+
+    for (i = 0; i < header.count; i++)
+    {
+        portEEPROM_READ(&record, TASK_SET_RECORD_ADDRESS(i), sizeof(record));
+
+        if (createTaskCommand('p', record.name, record.kernel, record.param, now + record.offset, record.period, record.duration, NULL) == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY)
+        {
+            return pdFALSE;
+        }
+    }
+
+    return pdTRUE;
+}
+
+/* Invalidates the snapshot so the next reset starts with no task set. */
+void eraseTaskSet(void)
+{
+    uint8_t magic = 0xFF;
+
+    portEEPROM_WRITE(&magic, configTASK_SET_EEPROM_ADDRESS, 1);
+}
+
+#endif /* configUSE_TASK_SET_SNAPSHOT */
+
+/* Reports and deletes a task addressed by a command.  Only jobs can be
+deleted, not the idle, timer or command tasks. */
+static void deleteTaskCommand(TCB_t *temp)
+{
+    if (taskIS_JOB(temp) == pdFALSE)
+    {
+        return;
+    }
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        uint8_t payload[1 + configMAX_TASK_NAME_LEN];
+
+        payload[0] = temp->taskId;
+        strncpy((char *)&payload[1], temp->pcName, configMAX_TASK_NAME_LEN - 1);
+        payload[configMAX_TASK_NAME_LEN] = 0;
+        sendFrame('D', payload, 2 + strlen((char *)&payload[1]));
+    }
+    else
+#endif
+    {
+        print_string(temp->pcName);
+        print_literal("-Del\n");
+    }
+
+    vTaskDelete(temp);
+}
+
+/* Deletes every job with the given name, returning how many there were. */
+UBaseType_t deleteTask(const char *taskName)
+{
+    TCB_t *temp;
+    UBaseType_t deleted = 0;
+
+    while ((temp = xTaskGetHandleFromName(taskName)) != NULL && taskIS_JOB(temp) != pdFALSE)
+    {
+        deleteTaskCommand(temp);
+        deleted++;
+    }
+
+    return deleted;
+}
+
+/* Resolves the task a text command refers to, by name or as #<id>. */
+static TCB_t *findTaskCommand(const char *reference)
+{
+    if (reference == NULL)
+    {
+        return NULL;
+    }
+
+    if (reference[0] == '#')
+    {
+        return xTaskGetHandleFromId(atoi(reference + 1));
+    }
+
+    return xTaskGetHandleFromName(reference);
+}
+
+/* Creates a task from a 'p' or 'a' command, released at tick arrival. */
+static BaseType_t createTaskCommand(char type, const char *name, char function, const char *param, TickType_t arrival, TickType_t period, TickType_t duration, TaskHandle_t *handle)
+{
+    char *taskName = pvPortMalloc((MAX_TASK_NAME_LENGTH + 1) * sizeof(char));
+    char *taskParam = pvPortMalloc((MAX_TASK_NAME_LENGTH + 1) * sizeof(char));
+    TaskHandle_t created;
+    BaseType_t xReturn;
+
+    if (taskName == NULL || taskParam == NULL)
+    {
+        vPortFree(taskName);
+        vPortFree(taskParam);
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    strncpy(taskName, name, MAX_TASK_NAME_LENGTH);
+    taskName[MAX_TASK_NAME_LENGTH] = 0;
+    strncpy(taskParam, param, MAX_TASK_NAME_LENGTH);
+    taskParam[MAX_TASK_NAME_LENGTH] = 0;
+
+    xReturn = xTaskCreateJob(function, taskName, taskParam, (type == 'p') ? PERIODIC_TASK_PRIORITY : APERIODIC_TASK_PRIORITY,
+                             &created, arrival, period, duration);
+
+    if (xReturn != pdPASS)
+    {
+        vPortFree(taskName);
+        vPortFree(taskParam);
+        return xReturn;
+    }
+
+    ((TCB_t *)created)->jobFlags |= tskJOB_OWNS_STRINGS;
+
+    if (handle != NULL)
+    {
+        *handle = created;
+    }
+
+    return xReturn;
+}
+
+/* Largest server capacity for a server period of sp that keeps the current
+periodic tasks schedulable, rounded to the nearest tick. */
+static float suggestServerCapacity(uint8_t sp)
+{
+    uint8_t i;
+
+    float multiply = 1.0;
+
+    TCB_t *temp;
+
+    for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+    {
+        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+        if (temp->period > 0)
+        {
+            multiply *= (((float)temp->duration / (float)temp->period) + 1.0);
+        }
+    }
+
+    float result = (((2.0 - multiply) / multiply) * ((float)sp));
+
+    float decimal = result - (int)result;
+    result = result - decimal;
+
+    if (decimal >= 0.5)
+        result++;
+
+    return result;
+}
+
+/* Batch admission.  Records are created one at a time as they are parsed,
+and held off the ready lists until the whole batch has passed the admission
+test, so a batch may be larger than a command line or frame.  'B' commands
+add records to the open batch and 'b' adds the last records and commits it.
+If any record fails, every task of the batch is deleted again. */
+static struct
+{
+    BaseType_t open;
+    BaseType_t mode; /*< Set if the batch is the task set of a mode change. */
+    double utilisation;
+    UBaseType_t periodicTasks;
+} batch;
+
+/* Utilisation of the running periodic tasks other than excluded, counting
+timing changes that have not been applied yet. */
+static double periodicUtilisation(const TCB_t *excluded, UBaseType_t *count)
+{
+    UBaseType_t i;
+    TCB_t *temp;
+    double utilisation = 0;
+
+    *count = 0;
+
+    for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+    {
+        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+        if (temp->period > 0 && temp != excluded)
+        {
+#if (configUSE_TASK_RETIMING == 1)
+            if (temp->retimePending != 0)
+            {
+                utilisation += temp->newDuration / (double)temp->newPeriod;
+                (*count)++;
+                continue;
+            }
+#endif
+            utilisation += temp->duration / (double)temp->period;
+            (*count)++;
+        }
+    }
+
+    return utilisation;
+}
+
+/* Rate monotonic bound for n periodic tasks. */
+static BaseType_t withinRateMonotonicBound(double utilisation, UBaseType_t n)
+{
+    return (n == 0 || utilisation <= n * (pow(2, 1 / (double)n) - 1)) ? pdTRUE : pdFALSE;
+}
+
+/* A batch is admitted against the periodic tasks already running, and the
+task set of a mode change on its own. */
+static void batchOpen(BaseType_t mode)
+{
+    batch.open = pdTRUE;
+    batch.mode = mode;
+    batch.utilisation = 0;
+    batch.periodicTasks = 0;
+
+    if (mode == pdFALSE)
+    {
+        batch.utilisation = periodicUtilisation(NULL, &batch.periodicTasks);
+    }
+}
+
+/* The rate monotonic bound only falls as tasks are added, so a batch can be
+rejected as soon as the utilisation so far exceeds it. */
+static BaseType_t batchAdmit(UBaseType_t uxPriority, TickType_t period, TickType_t duration)
+{
+    if (uxPriority == PERIODIC_TASK_PRIORITY && period > 0)
+    {
+        batch.utilisation += duration / (double)period;
+        batch.periodicTasks++;
+
+        return withinRateMonotonicBound(batch.utilisation, batch.periodicTasks);
+    }
+
+    return pdTRUE;
+}
+
+/* Moves a newly created task from the ready lists to the batch. */
+static void batchStage(TCB_t *pxTCB)
+{
+    taskENTER_CRITICAL();
+    {
+        if (uxListRemove(&(pxTCB->xStateListItem)) == (UBaseType_t)0)
+        {
+            taskRESET_READY_PRIORITY(pxTCB->uxPriority);
+        }
+        vListInsertEnd(&xBatchTasks, &(pxTCB->xStateListItem));
+    }
+    taskEXIT_CRITICAL();
+}
+
+#if (configUSE_AUTO_PHASE == 1)
+
+/* Work, in ticks, of the periodic tasks in a list released at tick. */
+static TickType_t releasedDemand(const List_t *pxList, TickType_t tick)
+{
+    const ListItem_t *item;
+    TickType_t demand = 0;
+
+    for (item = listGET_HEAD_ENTRY(pxList); item != listGET_END_MARKER(pxList); item = listGET_NEXT(item))
+    {
+        const TCB_t *temp = (const TCB_t *)listGET_LIST_ITEM_OWNER(item);
+
+        if (temp->uxPriority == PERIODIC_TASK_PRIORITY && temp->period > 0 && temp->arrival <= tick &&
+            (tick - temp->arrival) % temp->period == 0)
+        {
+            demand += temp->duration;
+        }
+    }
+
+    return demand;
+}
+
+/* Hyperperiod of the periodic tasks in a list and one more period, capped at
+configAUTO_PHASE_HORIZON. */
+static TickType_t phaseHorizon(const List_t *pxList, TickType_t hyperperiod)
+{
+    const ListItem_t *item;
+
+    for (item = listGET_HEAD_ENTRY(pxList); item != listGET_END_MARKER(pxList); item = listGET_NEXT(item))
+    {
+        const TCB_t *temp = (const TCB_t *)listGET_LIST_ITEM_OWNER(item);
+        TickType_t a = hyperperiod, b = temp->period, t;
+
+        if (temp->uxPriority != PERIODIC_TASK_PRIORITY || temp->period == 0)
+        {
+            continue;
+        }
+
+        while (b != 0)
+        {
+            t = a % b;
+            a = b;
+            b = t;
+        }
+
+        if (hyperperiod / a > configAUTO_PHASE_HORIZON / temp->period)
+        {
+            return configAUTO_PHASE_HORIZON;
+        }
+        hyperperiod = hyperperiod / a * temp->period;
+    }
+
+    return (hyperperiod > configAUTO_PHASE_HORIZON) ? configAUTO_PHASE_HORIZON : hyperperiod;
+}
+
+/* Offset from now at which to release a new periodic task so that the most
+work released together with any of its jobs is as small as possible, over
+the hyperperiod.  Ties go to the offset that shares the fewest ticks of work
+over the hyperperiod, then to the earliest.  Only the command task changes
+the periodic task lists, so it walks them without stopping the scheduler. */
+TickType_t xTaskSuggestPhase(TickType_t period, TickType_t duration)
+{
+    const List_t *pxPeriodic = &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]);
+    TickType_t now = xTickCount;
+    TickType_t horizon = phaseHorizon(pxPeriodic, period);
+    TickType_t best = 0, bestPeak = portMAX_DELAY, bestShared = portMAX_DELAY;
+    TickType_t offset, release, demand, peak, shared;
+
+    /* Staged tasks of a mode change are timed from the switch instead. */
+    if (batch.open != pdFALSE && batch.mode == pdFALSE)
+    {
+        horizon = phaseHorizon(&xBatchTasks, horizon);
+    }
+
+    for (offset = 0; offset < period && bestShared > 0; offset++)
+    {
+        peak = duration;
+        shared = 0;
+
+        for (release = offset; release < horizon; release += period)
+        {
+            demand = releasedDemand(pxPeriodic, now + release);
+
+            if (batch.open != pdFALSE && batch.mode == pdFALSE)
+            {
+                demand += releasedDemand(&xBatchTasks, now + release);
+            }
+
+            shared += demand;
+
+            if (duration + demand > peak)
+            {
+                peak = duration + demand;
+            }
+        }
+
+        if (peak < bestPeak || (peak == bestPeak && shared < bestShared))
+        {
+            best = offset;
+            bestPeak = peak;
+            bestShared = shared;
+        }
+    }
+
+    return best;
+}
+
+#endif /* configUSE_AUTO_PHASE */
+
+/* Tick at which a task created by a command is first released, arrival
+ticks from now.  With configUSE_AUTO_PHASE, an arrival of tskAUTO_PHASE lets
+xTaskSuggestPhase() choose the phase of a periodic task. */
+static TickType_t releaseTick(char type, TickType_t arrival, TickType_t period, TickType_t duration)
+{
+#if (configUSE_AUTO_PHASE == 1)
+    if (arrival == tskAUTO_PHASE)
+    {
+        arrival = (type == 'p' && period > 0) ? xTaskSuggestPhase(period, duration) : 0;
+    }
+#else
+    (void)type;
+    (void)period;
+    (void)duration;
+#endif
+
+    return xTickCount + arrival;
+}
+
+/* Arrival field of a text command.  '*' asks for an automatic phase. */
+static TickType_t parseArrival(const char *token)
+{
+#if (configUSE_AUTO_PHASE == 1)
+    if (token[0] == '*')
+    {
+        return tskAUTO_PHASE;
+    }
+#endif
+
+    return atoi(token);
+}
+
+#if (configUSE_MODE_CHANGE == 1)
+static BaseType_t modeChangePending(void);
+#endif
+
+/* Tests one record and creates its task off the ready lists. */
+static BaseType_t batchAdd(char kind, const char *name, char function, const char *param, TickType_t arrival, TickType_t period, TickType_t duration)
+{
+    TaskHandle_t handle = NULL;
+
+    if (kind != 'p' && kind != 'a')
+    {
+        return pdFALSE;
+    }
+
+#if (configUSE_MODE_CHANGE == 1)
+    /* The staged set of a requested mode change cannot be added to. */
+    if (modeChangePending() != pdFALSE)
+    {
+        return pdFALSE;
+    }
+#endif
+
+    if (batch.open == pdFALSE)
+    {
+        batchOpen(pdFALSE);
+    }
+
+    if (batchAdmit((kind == 'p') ? PERIODIC_TASK_PRIORITY : APERIODIC_TASK_PRIORITY, period, duration) == pdFALSE)
+    {
+        return pdFALSE;
+    }
+
+    /* Tasks of a mode change are released relative to the switch. */
+    if (batch.mode == pdFALSE)
+    {
+        arrival = releaseTick(kind, arrival, period, duration);
+    }
+#if (configUSE_AUTO_PHASE == 1)
+    else if (arrival == tskAUTO_PHASE)
+    {
+        arrival = 0;
+    }
+#endif
+
+    if (createTaskCommand(kind, name, function, param, arrival, period, duration, &handle) != pdPASS)
+    {
+        return pdFALSE;
+    }
+
+    batchStage((TCB_t *)handle);
+
+    return pdTRUE;
+}
+
+/* Makes every task of the batch ready, or deletes them all. */
+static void batchClose(BaseType_t commit)
+{
+    TCB_t *pxTCB;
+
+#if (configUSE_MODE_CHANGE == 1)
+    /* A requested mode change keeps its staged set until it is applied. */
+    if (modeChangePending() != pdFALSE)
+    {
+        return;
+    }
+#endif
+
+    while (listLIST_IS_EMPTY(&xBatchTasks) == pdFALSE)
+    {
+        pxTCB = (TCB_t *)listGET_OWNER_OF_HEAD_ENTRY(&xBatchTasks);
+
+        if (commit != pdFALSE)
+        {
+            taskENTER_CRITICAL();
+            {
+                (void)uxListRemove(&(pxTCB->xStateListItem));
+                prvAddTaskToReadyList(pxTCB);
+            }
+            taskEXIT_CRITICAL();
+        }
+        else
+        {
+            vTaskDelete(pxTCB);
+        }
+    }
+
+    batch.open = pdFALSE;
+    batch.mode = pdFALSE;
+}
+
+#if (configUSE_TASK_RETIMING == 1)
+
+/* Changes the timing of a periodic task from its next release, keeping its
+phase.  A job already released runs to its end with the old timing, and the
+change is applied then; otherwise it is applied at once.  The task set is
+admitted again with the new timing. */
+BaseType_t xTaskSetTiming(TaskHandle_t xTask, TickType_t period, TickType_t duration, TickType_t phase)
+{
+    TCB_t *pxTCB = prvGetTCBFromHandle(xTask);
+    UBaseType_t count;
+    double utilisation;
+
+    if (pxTCB->uxPriority != PERIODIC_TASK_PRIORITY || pxTCB->period == 0 || period == 0 || duration > period)
+    {
+        return pdFAIL;
+    }
+
+    utilisation = periodicUtilisation(pxTCB, &count) + duration / (double)period;
+
+    if (withinRateMonotonicBound(utilisation, count + 1) == pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        if (pxTCB->arrival + pxTCB->cycle * pxTCB->period > xTickCount)
+        {
+            /* Between jobs: the new timing starts at the release the task
+            is waiting for. */
+            pxTCB->arrival += pxTCB->cycle * pxTCB->period + phase;
+            pxTCB->period = period;
+            pxTCB->duration = duration;
+            pxTCB->cycle = 0;
+            pxTCB->retimePending = 0;
+        }
+        else
+        {
+            pxTCB->newPeriod = period;
+            pxTCB->newDuration = duration;
+            pxTCB->newPhase = phase;
+            pxTCB->retimePending = 1;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return pdPASS;
+}
+
+#endif /* configUSE_TASK_RETIMING */
+
+#if (configUSE_MODE_CHANGE == 1)
+
+/* Mode changes.  The new task set and server are staged as a batch, and
+once requested the tick watches for an instant at which the old set can be
+dropped without cutting a job short, unless the policy is to abort.  The
+command task, which no job can preempt, then swaps the sets in one step. */
+static struct
+{
+    volatile BaseType_t pending;
+    volatile BaseType_t due;
+    UBaseType_t policy;
+    TickType_t capacity;
+    TickType_t period;
+    TickType_t requested;
+    TickType_t hyperperiod;
+    TickType_t tick; /*< The tick the switch was found due at. */
+} modeChange;
+
+static BaseType_t modeChangePending(void)
+{
+    return modeChange.pending;
+}
+
+/* Maps the policy letter of an 'M' command: 'a' aborts the running jobs,
+'i' waits for an idle instant and 'h' for a hyperperiod boundary. */
+static UBaseType_t modeChangePolicy(char policy)
+{
+    if (policy == 'a')
+    {
+        return tskMODE_CHANGE_ABORT;
+    }
+
+    return (policy == 'h') ? tskMODE_CHANGE_HYPERPERIOD : tskMODE_CHANGE_IDLE;
+}
+
+static TickType_t greatestCommonDivisor(TickType_t a, TickType_t b)
+{
+    TickType_t t;
+
+    while (b != 0)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+BaseType_t xTaskModeChangeBegin(TickType_t capacity, TickType_t period)
+{
+    if (modeChange.pending != pdFALSE || batch.open != pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    batchOpen(pdTRUE);
+    modeChange.capacity = capacity;
+    modeChange.period = period;
+
+    return pdPASS;
+}
+
+BaseType_t xTaskModeChangeAdd(TaskFunction_t pxTaskCode, const char *const pcName, const configSTACK_DEPTH_TYPE usStackDepth, void *const pvParameters, UBaseType_t uxPriority, TickType_t arrival, TickType_t period, TickType_t duration)
+{
+    TaskHandle_t handle = NULL;
+
+    if (batch.mode == pdFALSE || modeChange.pending != pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    if (batchAdmit(uxPriority, period, duration) == pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    if (xTaskCreatePeriodic(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, &handle, arrival, period, duration) != pdPASS)
+    {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    ((TCB_t *)handle)->jobFlags |= tskJOB_MODE_MEMBER;
+    batchStage((TCB_t *)handle);
+
+    return pdPASS;
+}
+
+BaseType_t xTaskModeChangeRequest(UBaseType_t policy)
+{
+    TCB_t *temp;
+    UBaseType_t i;
+    TickType_t hyperperiod = 1;
+
+    if (batch.mode == pdFALSE || modeChange.pending != pdFALSE)
+    {
+        return pdFAIL;
+    }
+
+    /* Hyperperiod of the running set.  If it overflows the switch waits for
+    an idle instant instead. */
+    for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+    {
+        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+        if (temp->period > 0 && hyperperiod > 0)
+        {
+            TickType_t factor = temp->period / greatestCommonDivisor(hyperperiod, temp->period);
+
+            hyperperiod = (hyperperiod <= portMAX_DELAY / 2 / factor) ? hyperperiod * factor : 0;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    {
+        modeChange.policy = policy;
+        modeChange.requested = xTickCount;
+        modeChange.hyperperiod = hyperperiod;
+        modeChange.due = pdFALSE;
+        modeChange.pending = pdTRUE;
+    }
+    taskEXIT_CRITICAL();
+
+    return pdPASS;
+}
+
+void vTaskModeChangeCancel(void)
+{
+    if (modeChange.pending == pdFALSE && batch.mode != pdFALSE)
+    {
+        batchClose(pdFALSE);
+    }
+}
+
+/* Deletes the jobs of the running set from one ready list.  Only tasks the
+kernel created, from commands or for an earlier mode change, are part of a
+mode, so tasks the application made itself and the command task stay. */
+static void modeChangeRetire(List_t *pxList)
+{
+    const ListItem_t *item = listGET_HEAD_ENTRY(pxList);
+    const ListItem_t *next;
+    TCB_t *temp;
+
+    while (item != listGET_END_MARKER(pxList))
+    {
+        next = listGET_NEXT(item);
+        temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
+
+        if (temp != pxCurrentTCB && (temp->jobFlags & (tskJOB_OWNS_STRINGS | tskJOB_MODE_MEMBER)) != 0)
+        {
+            vTaskDelete(temp);
+        }
+
+        item = next;
+    }
+}
+
+static void modeChangeApply(void)
+{
+    const ListItem_t *item;
+    TCB_t *temp;
+    uint8_t i;
+
+    vTaskSuspendAll();
+    {
+        modeChangeRetire(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+        modeChangeRetire(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]));
+
+        for (i = 0; i < MAX_REFILLS; i++)
+        {
+            refills[i].refillAmount = 0;
+        }
+        serverCapacity = modeChange.capacity;
+        serverPeriod = modeChange.period;
+
+        for (item = listGET_HEAD_ENTRY(&xBatchTasks); item != listGET_END_MARKER(&xBatchTasks); item = listGET_NEXT(item))
+        {
+            temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
+            temp->arrival += modeChange.tick;
+        }
+
+        modeChange.due = pdFALSE;
+        modeChange.pending = pdFALSE;
+        batchClose(pdTRUE);
+    }
+    (void)xTaskResumeAll();
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
+    {
+        uint8_t payload[FRAME_VARINT_SIZE];
+
+        sendFrame('M', payload, putVarint(payload, modeChange.tick) - payload);
+    }
+    else
+#endif
+    {
+        print_literal("M:");
+        print_number(modeChange.tick);
+        print_literal("\n");
+    }
+
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+    saveTaskSet();
+#endif
+}
+
+#endif /* configUSE_MODE_CHANGE */
+
+/* Splits the next '-' separated field in place. */
+static char *getBatchField(char **cursor)
+{
+    char *field = *cursor;
+
+    if (*field == 0)
+    {
+        return NULL;
+    }
+
+    while (**cursor != '-' && **cursor != 0)
+    {
+        (*cursor)++;
+    }
+
+    if (**cursor == '-')
+    {
+        **cursor = 0;
+        (*cursor)++;
+    }
+
+    return field;
+}
+
+/* Tests and creates one text batch record, returning where the next one
+starts, or NULL if the record is malformed or fails. */
+static char *batchAddText(char *in)
+{
+    char *field[7];
+    uint8_t i;
+
+    for (i = 0; i < 7; i++)
+    {
+        field[i] = getBatchField(&in);
+
+        if (field[i] == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    if (batchAdd(field[0][0], field[1], field[2][0], field[3], parseArrival(field[4]), atoi(field[5]), atoi(field[6])) == pdFALSE)
+    {
+        return NULL;
+    }
+
+    return in;
+}
+
+void parseInput(char *input)
+{
+    char *token;
+
+    token = strtok(input, " ");
+
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+    char command = token[0];
+#endif
+
+    if (token[0] == 'd')
+    {
+        token = strtok(NULL, " ");
+
+        /* '#' addresses a single task by its ID. */
+        if (token != NULL && token[0] == '#')
+        {
+            TCB_t *temp = findTaskCommand(token);
+
+            if (temp != NULL)
+            {
+                deleteTaskCommand(temp);
+            }
+        }
+        else if (token != NULL)
+        {
+            deleteTask(token);
+        }
+    }
+    else if (token[0] == 'p' || token[0] == 'a')
+    {
+        char type = token[0];
+        char *taskName = strtok(NULL, " ");
+        char *taskFunction = strtok(NULL, " ");
+        char *taskParam = strtok(NULL, " ");
+
+        token = strtok(NULL, " ");
+        TickType_t arrival = parseArrival(token);
+        token = strtok(NULL, " ");
+        TickType_t period = atoi(token);
+        token = strtok(NULL, " ");
+        TickType_t duration = atoi(token);
+
+        createTaskCommand(type, taskName, taskFunction[0], taskParam, releaseTick(type, arrival, period, duration), period, duration, NULL);
+    }
+#if (configUSE_APERIODIC_STATS == 1)
+    else if (token[0] == 'l')
+    {
+        reportAperiodicStats();
+    }
+#endif
+#if (configGENERATE_RUN_TIME_STATS == 1)
+    else if (token[0] == 'u')
+    {
+        reportRunTime();
+    }
+#endif
+#if (configUSE_TRACE_RECORDER == 1)
+    else if (token[0] == 'g')
+    {
+        traceRecordsReport();
+    }
+#endif
+#if (configUSE_OVERHEAD_PROFILER == 1)
+    else if (token[0] == 'o')
+    {
+        reportOverhead();
+        token = strtok(NULL, " ");
+
+        if (token != NULL && token[0] == 'r')
+        {
+            overheadClear();
+        }
+    }
+#endif
+#if (configUSE_STACK_PROFILING == 1)
+    else if (token[0] == 'h')
+    {
+        token = strtok(NULL, " ");
+        reportStackProfile((token != NULL && token[0] == 'w') ? pdTRUE : pdFALSE);
+    }
+#endif
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+    else if (token[0] == 'e')
+    {
+        eraseTaskSet();
+    }
+#endif
+    else if (token[0] == 's')
+    {
+        token = strtok(NULL, " ");
+        TickType_t capacity = atoi(token);
+
+        token = strtok(NULL, " ");
+        TickType_t period = atoi(token);
+
+        initialiseServer(capacity, period);
+    }
+    else if (token[0] == 'c')
+    {
+        token = strtok(NULL, " ");
+
+        float result = suggestServerCapacity(atoi(token));
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+        if (framedMode != pdFALSE)
+        {
+            uint8_t payload[FRAME_VARINT_SIZE];
+            sendFrame('K', payload, putVarint(payload, (TickType_t)result) - payload);
+        }
+        else
+#endif
+        {
+            print_literal("C:");
+            print_float(result);
+            print_literal("\n");
+        }
+    }
+#if (configUSE_FRAMED_COMMANDS == 1)
+    else if (token[0] == 'f')
+    {
+        /* The GUI switches to framed commands; it waits for this frame
+        before sending any, so older firmware leaves it in text mode. */
+        uint8_t version = FRAME_VERSION;
+
+        framedMode = pdTRUE;
+        sendFrame('F', &version, 1);
+    }
+#endif
+    else if (token[0] == 'b' || token[0] == 'B')
+    {
+        /* Records are separated by '-' as well as their fields, e.g.
+        b p-t1-w-x-0-10-2-a-t2-n-5-3-0-4-1 */
+        char *in = strtok(NULL, " ");
+
+        while (in != NULL && *in != 0)
+        {
+            in = batchAddText(in);
+        }
+
+        if (in == NULL)
+        {
+            batchClose(pdFALSE);
+            print_literal("Cant schedule");
+            return;
+        }
+
+        /* The task set of a mode change is committed by 'M'. */
+        if (token[0] == 'b' && batch.mode == pdFALSE)
+        {
+            batchClose(pdTRUE);
+        }
+    }
+#if (configUSE_TASK_RETIMING == 1)
+    else if (token[0] == 'r')
+    {
+        TCB_t *temp = findTaskCommand(strtok(NULL, " "));
+
+        token = strtok(NULL, " ");
+        TickType_t period = atoi(token);
+        token = strtok(NULL, " ");
+        TickType_t duration = atoi(token);
+        token = strtok(NULL, " ");
+        TickType_t phase = atoi(token);
+
+        if (temp == NULL || xTaskSetTiming(temp, period, duration, phase) != pdPASS)
+        {
+            print_literal("Cant schedule");
+        }
+    }
+#endif
+#if (configUSE_MODE_CHANGE == 1)
+    else if (token[0] == 'm')
+    {
+        token = strtok(NULL, " ");
+        TickType_t capacity = atoi(token);
+
+        token = strtok(NULL, " ");
+        TickType_t period = atoi(token);
+
+        if (xTaskModeChangeBegin(capacity, period) != pdPASS)
+        {
+            print_literal("Cant schedule");
+        }
+    }
+    else if (token[0] == 'M')
+    {
+        token = strtok(NULL, " ");
+
+        if (token == NULL || xTaskModeChangeRequest(modeChangePolicy(token[0])) != pdPASS)
+        {
+            print_literal("Cant schedule");
+        }
+    }
+#endif
+
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+    /* Commands that change the periodic task set or the server are saved. */
+    if (command == 'p' || command == 'd' || command == 's' || command == 'b')
+    {
+        saveTaskSet();
+    }
+#endif
+}
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+/* State snapshot, sent as one 'Q' frame in reply to 'q':
+
+    flags, tick, server capacity, server period,
+    replenishment count, { tick, amount } per pending replenishment,
+    heap free, heap minimum ever free,
+    task count, { ID, type, state, period, duration, next release,
+                  job count, stack high water mark } per task
+
+Numbers are varints and the rest single bytes.  The type is 'p', 'a' or 's'
+for other tasks, and the state an eTaskState.  Tasks that do not fit in
+configSTATE_SNAPSHOT_LENGTH bytes are left out and bit 0 of flags is set.  No
+task can run while the snapshot is built, and the server is read under a
+short critical section, so the frame is consistent.  Only the command task
+sends snapshots, so the frame is built in a static buffer rather than on the
+heap. */
+#define SNAPSHOT_TRUNCATED 0x01
+#define SNAPSHOT_LENGTH_MAX configSTATE_SNAPSHOT_LENGTH
+
+static uint8_t snapshotFrame[SNAPSHOT_LENGTH_MAX];
+
+static uint8_t snapshotTaskState(const TCB_t *pxTCB)
+{
+    const List_t *container = listLIST_ITEM_CONTAINER(&(pxTCB->xStateListItem));
+
+    if (pxTCB == pxCurrentTCB)
+    {
+        return eRunning;
+    }
+
+    if (container == pxDelayedTaskList || container == pxOverflowDelayedTaskList)
+    {
+        return eBlocked;
+    }
+
+#if (INCLUDE_vTaskSuspend == 1)
+    if (container == &xSuspendedTaskList)
+    {
+        return (listLIST_ITEM_CONTAINER(&(pxTCB->xEventListItem)) == NULL) ? eSuspended : eBlocked;
+    }
+#endif
+
+    /* Tasks staged by a batch cannot run yet. */
+    if (container == &xBatchTasks)
+    {
+        return eSuspended;
+    }
+
+    return (container == NULL) ? eDeleted : eReady;
+}
+
+static BaseType_t snapshotAppend(uint8_t *out, uint8_t *length, const uint8_t *record, const uint8_t *end)
+{
+    uint8_t size = end - record;
+
+    if (*length + size > SNAPSHOT_LENGTH_MAX)
+    {
+        return pdFALSE;
+    }
+
+    memcpy(&out[*length], record, size);
+    *length += size;
+
+    return pdTRUE;
+}
+
+static uint8_t snapshotEncode(uint8_t *out, const uint8_t *server, const uint8_t *serverEnd)
+{
+    uint8_t record[3 + 5 * FRAME_VARINT_SIZE];
+    uint8_t *end;
+    uint8_t length = 0;
+    uint8_t flags = 0;
+    uint8_t tasks = 0;
+    uint8_t countAt;
+    uint8_t id;
+    TCB_t *temp;
+
+    (void)snapshotAppend(out, &length, &flags, &flags + 1);
+    (void)snapshotAppend(out, &length, server, serverEnd);
+
+    end = putVarint(record, (TickType_t)xPortGetFreeHeapSize());
+    end = putVarint(end, (TickType_t)xPortGetMinimumEverFreeHeapSize());
+    countAt = length + (end - record);
+    *end++ = 0;
+    (void)snapshotAppend(out, &length, record, end);
+
+    for (id = 0; id < configTASK_REGISTRY_SIZE; id++)
+    {
+        temp = taskRegistry[id];
+
+        if (temp == NULL)
+        {
+            continue;
+        }
+
+        record[0] = id;
+        record[1] = (temp->uxPriority == APERIODIC_TASK_PRIORITY) ? 'a' : ((temp->period > 0) ? 'p' : 's');
+        record[2] = snapshotTaskState(temp);
+        end = putVarint(&record[3], temp->period);
+        end = putVarint(end, temp->duration);
+        end = putVarint(end, (temp->period > 0) ? temp->arrival + temp->cycle * temp->period : temp->arrival);
+        end = putVarint(end, (TickType_t)temp->cycle);
+#if (INCLUDE_uxTaskGetStackHighWaterMark == 1)
+        end = putVarint(end, (TickType_t)prvTaskCheckFreeStackSpace((uint8_t *)temp->pxStack));
+#else
+        end = putVarint(end, 0);
+#endif
+
+        if (snapshotAppend(out, &length, record, end) == pdFALSE)
+        {
+            flags |= SNAPSHOT_TRUNCATED;
+            break;
+        }
+        tasks++;
+    }
+
+    out[0] = flags;
+    out[countAt] = tasks;
+
+    return length;
+}
+
+static void snapshotSend(void)
+{
+    uint8_t server[(3 + 2 * MAX_REFILLS) * FRAME_VARINT_SIZE + 1];
+    uint8_t *serverEnd;
+    uint8_t *pending;
+    uint8_t length;
+    uint8_t i;
+
+    vTaskSuspendAll();
+    {
+        /* Only the tick changes the server while tasks are held off. */
+        taskENTER_CRITICAL();
+        {
+            serverEnd = putVarint(server, xTickCount);
+            serverEnd = putVarint(serverEnd, serverCapacity);
+            serverEnd = putVarint(serverEnd, serverPeriod);
+            pending = serverEnd++;
+            *pending = 0;
+
+            for (i = 0; i < MAX_REFILLS; i++)
+            {
+                if (refills[i].refillAmount > 0)
+                {
+                    serverEnd = putVarint(serverEnd, refills[i].refillTick);
+                    serverEnd = putVarint(serverEnd, refills[i].refillAmount);
+                    (*pending)++;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        length = snapshotEncode(snapshotFrame, server, serverEnd);
+    }
+    (void)xTaskResumeAll();
+
+    sendFrame('Q', snapshotFrame, length);
+}
+
+/* Decodes a task reference, which is a name, or an empty name followed by
+the ID of the task.  *task is NULL if there is no such task. */
+static const uint8_t *getTaskReference(const uint8_t *in, const uint8_t *end, TCB_t **task)
+{
+    const char *name;
+    TickType_t id;
+
+    *task = NULL;
+
+    in = getString(in, end, &name);
+    if (in == NULL)
+    {
+        return NULL;
+    }
+
+    if (name[0] != 0)
+    {
+        *task = xTaskGetHandleFromName(name);
+        return in;
+    }
+
+    in = getVarint(in, end, &id);
+    if (in != NULL)
+    {
+        *task = xTaskGetHandleFromId(id);
+    }
+
+    return in;
+}
+
+/* Decodes the fields shared by 'p', 'a' and batch records. */
+static const uint8_t *getTaskFields(const uint8_t *in, const uint8_t *end, const char **name, char *function, const char **param, TickType_t *arrival, TickType_t *period, TickType_t *duration)
+{
+    in = getString(in, end, name);
+
+    if (in == NULL || in >= end)
+    {
+        return NULL;
+    }
+    *function = (char)*in++;
+
+    in = getString(in, end, param);
+    in = getVarint(in, end, arrival);
+    in = getVarint(in, end, period);
+    return getVarint(in, end, duration);
+}
+
+/* Handles one frame held in the command buffer, starting at its length
+byte.  Every frame is answered, with a nack if it cannot be carried out. */
+static void parseFrame(const uint8_t *frame, uint8_t length, BaseType_t overflow)
+{
+    const uint8_t *in = frame + 2;
+    const uint8_t *end = frame + 1 + frame[0];
+    uint8_t opcode = (length > 1) ? frame[1] : 0;
+    const char *name;
+    const char *param;
+    char function;
+    TickType_t arrival;
+    TickType_t period;
+    TickType_t duration;
+    TickType_t count;
+    TickType_t i;
+    BaseType_t result = pdPASS;
+    TaskHandle_t handle = NULL;
+    uint8_t ack[2] = {opcode, tskNO_TASK_ID};
+    uint8_t ackLength = 1;
+
+    if (overflow != pdFALSE || frame[0] == 0 || length != frame[0] + 3)
+    {
+        sendNack(opcode, FRAME_NACK_MALFORMED);
+        return;
+    }
+
+    if (crc16Block(0xFFFF, frame, frame[0] + 1) != (uint16_t)(end[0] | ((uint16_t)end[1] << 8)))
+    {
+        sendNack(opcode, FRAME_NACK_CRC);
+        return;
+    }
+
+    switch (opcode)
+    {
+    case 'p':
+    case 'a':
+        if (getTaskFields(in, end, &name, &function, &param, &arrival, &period, &duration) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        result = createTaskCommand((char)opcode, name, function, param, releaseTick((char)opcode, arrival, period, duration), period, duration, &handle);
+
+        /* The ack carries the ID the GUI addresses the task by. */
+        if (result == pdPASS)
+        {
+            ack[1] = ((TCB_t *)handle)->taskId;
+            ackLength = 2;
+        }
+        break;
+
+    case 'd':
+    {
+        TCB_t *temp;
+
+        /* A name deletes every task with that name, and an empty name
+        followed by an ID a single task.  Each deleted task is reported with
+        a 'D' frame. */
+        if (getTaskReference(in, end, &temp) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        if (temp == NULL || taskIS_JOB(temp) == pdFALSE)
+        {
+            sendNack(opcode, FRAME_NACK_NOT_FOUND);
+            return;
+        }
+
+        if (in[0] != 0)
+        {
+            deleteTask((const char *)in);
+        }
+        else
+        {
+            deleteTaskCommand(temp);
+        }
+        break;
+    }
+
+    case 's':
+        in = getVarint(in, end, &arrival);
+        if (getVarint(in, end, &period) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        /* Replies with a 'C' frame. */
+        initialiseServer(arrival, period);
+        break;
+
+    case 'c':
+        if (getVarint(in, end, &period) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+        else
+        {
+            uint8_t payload[FRAME_VARINT_SIZE];
+
+            sendFrame('K', payload, putVarint(payload, (TickType_t)suggestServerCapacity(period)) - payload);
+        }
+        break;
+
+    case 'b':
+    case 'B':
+        /* Records are decoded straight from the frame and created as they
+        pass the admission test. */
+        in = getVarint(in, end, &count);
+
+        for (i = 0; i < count && in != NULL; i++)
+        {
+            char kind = (in < end) ? (char)*in++ : 0;
+
+            in = getTaskFields(in, end, &name, &function, &param, &arrival, &period, &duration);
+
+            if (in != NULL && batchAdd(kind, name, function, param, arrival, period, duration) == pdFALSE)
             {
-                mtCOVERAGE_TEST_MARKER();
+                batchClose(pdFALSE);
+                sendNack(opcode, FRAME_NACK_UNSCHEDULABLE);
+                return;
             }
         }
 
-        uxTaskNumber++;
+        if (in == NULL)
+        {
+            batchClose(pdFALSE);
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        if (opcode == 'b' && batch.mode == pdFALSE)
+        {
+            batchClose(pdTRUE);
+        }
+        break;
+
+#if (configUSE_TASK_RETIMING == 1)
+    case 'r':
+    {
+        TCB_t *temp;
+
+        in = getTaskReference(in, end, &temp);
+        in = getVarint(in, end, &period);
+        in = getVarint(in, end, &duration);
+        if (getVarint(in, end, &arrival) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        if (temp == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_NOT_FOUND);
+            return;
+        }
+
+        if (xTaskSetTiming(temp, period, duration, arrival) != pdPASS)
+        {
+            sendNack(opcode, FRAME_NACK_UNSCHEDULABLE);
+            return;
+        }
+        break;
+    }
+#endif
+
+#if (configUSE_MODE_CHANGE == 1)
+    case 'm':
+        in = getVarint(in, end, &arrival);
+        if (getVarint(in, end, &period) == NULL)
+        {
+            sendNack(opcode, FRAME_NACK_MALFORMED);
+            return;
+        }
+
+        if (xTaskModeChangeBegin(arrival, period) != pdPASS)
+        {
+            sendNack(opcode, FRAME_NACK_UNSCHEDULABLE);
+            return;
+        }
+        break;
+
+    case 'M':
+        if (in >= end || xTaskModeChangeRequest(modeChangePolicy((char)*in)) != pdPASS)
+        {
+            sendNack(opcode, FRAME_NACK_UNSCHEDULABLE);
+            return;
+        }
+        break;
+#endif
+
+    case 'q':
+        snapshotSend();
+        return;
+
+#if (configUSE_APERIODIC_STATS == 1)
+    case 'l':
+        reportAperiodicStats();
+        return;
+#endif
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+    case 'u':
+        runTimeSend();
+        return;
+#endif
+
+#if (configUSE_TRACE_RECORDER == 1)
+    case 'g':
+        traceRecordsSend();
+        return;
+#endif
 
-#if (configUSE_TRACE_FACILITY == 1)
+#if (configUSE_OVERHEAD_PROFILER == 1)
+    case 'o':
+        overheadSend();
+
+        if (in < end && in[0] == 1)
         {
-            /* Add a counter into the TCB for tracing only. */
-            pxNewTCB->uxTCBNumber = uxTaskNumber;
+            overheadClear();
         }
-#endif /* configUSE_TRACE_FACILITY */
-        traceTASK_CREATE(pxNewTCB);
+        return;
+#endif
 
-        prvAddTaskToReadyList(pxNewTCB);
+    case 'f':
+    {
+        uint8_t version = FRAME_VERSION;
 
-        portSETUP_TCB(pxNewTCB);
+        sendFrame('F', &version, 1);
+        return;
     }
-    taskEXIT_CRITICAL();
 
-    if (xSchedulerRunning != pdFALSE)
+    case 't':
+        /* Back to text commands.  The ack is the last frame sent. */
+        sendFrame('A', &opcode, 1);
+        framedMode = pdFALSE;
+        return;
+
+    default:
+        sendNack(opcode, FRAME_NACK_MALFORMED);
+        return;
+    }
+
+    if (result != pdPASS)
     {
-        /* If the created task is of a higher priority than the current task
-        then it should run now. */
-        if (pxCurrentTCB->uxPriority < pxNewTCB->uxPriority)
-        {
-            taskYIELD_IF_USING_PREEMPTION();
-        }
-        else
-        {
-            mtCOVERAGE_TEST_MARKER();
-        }
+        /* Creation fails for lack of heap, or for an unknown job kernel. */
+        sendNack(opcode, (result == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY) ? FRAME_NACK_NO_MEMORY : FRAME_NACK_MALFORMED);
     }
-    else
+    else if (opcode != 'd' && opcode != 's' && opcode != 'c')
     {
-        mtCOVERAGE_TEST_MARKER();
+        sendFrame('A', ack, ackLength);
     }
-}
-/*-----------------------------------------------------------*/
-void deleteTask(char *taskName)
-{
-    TCB_t *temp;
 
-    for (int i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+#if (configUSE_TASK_SET_SNAPSHOT == 1)
+    if (opcode == 'p' || opcode == 'd' || opcode == 's' || opcode == 'b')
     {
+        saveTaskSet();
+    }
+#endif
+}
 
-        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+#endif /* configUSE_FRAMED_COMMANDS */
 
-        if (strcmp(temp->pcName, taskName) == 0)
-        {
-            vPortFree(temp->pcName);
-            vTaskDelete(temp);
-            print_string(temp->pcName);
-            print_string("-Del\n");
-        }
+/* Serial input waiting to be parsed.  Stream buffers wake a reader on a byte
+count rather than on a delimiter, so the command task is notified directly
+when a newline is received instead. */
+static StreamBufferHandle_t commandStream = NULL;
+static TaskHandle_t commandTaskHandle = NULL;
+static char commandLine[configCOMMAND_LINE_LENGTH];
+
+/* A byte that finds the stream full cuts its line or frame short.  The
+interrupt then notes how many bytes it had queued before it, and drops input
+until the command task has thrown away the part it has, up to that point, and
+a new line or frame begins. */
+static uint16_t commandBytesQueued = 0;
+static volatile uint16_t commandGapAt = 0;
+static volatile BaseType_t commandGap = pdFALSE;
+static BaseType_t commandSkipping = pdFALSE;
+static BaseType_t commandLineStart = pdTRUE;
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+
+/* Frame bytes still to come once a frame has started.  The length byte has
+not been seen yet while this holds FRAME_LENGTH_PENDING. */
+#define FRAME_LENGTH_PENDING 0xFFFF
+
+static uint16_t frameRemainingFromISR = 0;
+
+/* Returns the new count of bytes remaining in the current frame. */
+static uint16_t frameCountByte(uint16_t remaining, uint8_t c)
+{
+    if (remaining == 0)
+    {
+        return (c == FRAME_SYNC) ? FRAME_LENGTH_PENDING : 0;
     }
+
+    if (remaining == FRAME_LENGTH_PENDING)
+    {
+        /* Opcode and payload, then the CRC. */
+        return (uint16_t)c + 2;
+    }
+
+    return remaining - 1;
 }
 
-void parseInput(char *input)
-{
-    char *token;
+#endif /* configUSE_FRAMED_COMMANDS */
 
-    token = strtok(input, " ");
+void commandReceiveFromISR(char c, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    BaseType_t complete = (c == '\n') ? pdTRUE : pdFALSE;
+    BaseType_t start = commandLineStart;
 
-    if (token[0] == 'd')
+    if (commandStream == NULL)
     {
-        token = strtok(NULL, " ");
-        deleteTask(token);
+        return;
     }
-    else if (token[0] == 'p' || token[0] == 'a')
+
+    commandLineStart = complete;
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    if (framedMode != pdFALSE)
     {
-        uint8_t function = (token[0] == 'p') ? 1 : 0;
-
-        char *taskName = pvPortMalloc((MAX_TASK_NAME_LENGTH + 1) * sizeof(char));
-        strcpy(taskName, strtok(NULL, " "));
-        TickType_t period;
-        TickType_t duration;
-        TickType_t arrival;
-        char *taskFunction;
-        taskFunction = strtok(NULL, " ");
-        char *taskParam = pvPortMalloc((MAX_TASK_NAME_LENGTH + 1) * sizeof(char));
-        strcpy(taskParam, strtok(NULL, " "));
-        token = strtok(NULL, " ");
-        arrival = atoi(token) + xTickCount;
-        token = strtok(NULL, " ");
-        period = atoi(token);
-        token = strtok(NULL, " ");
-        duration = atoi(token);
+        uint16_t previous = frameRemainingFromISR;
 
-        if (function == 1)
-        {
-            if (taskFunction[0] == 'w')
-            {
-                xTaskCreatePeriodic(taskPeriodic, taskName, 100, taskParam, PERIODIC_TASK_PRIORITY, NULL, xTickCount, period, duration);
-            }
-            else
-            {
-                xTaskCreatePeriodic(taskPeriodicNumber, taskName, 100, taskParam, PERIODIC_TASK_PRIORITY, NULL, xTickCount, period, duration);
-            }
-        }
-        else
+        frameRemainingFromISR = frameCountByte(previous, (uint8_t)c);
+
+        /* Noise between frames is not worth waking the task for. */
+        if (previous == 0 && frameRemainingFromISR == 0)
         {
-            if (taskFunction[0] == 'w')
-            {
-                xTaskCreatePeriodic(taskAperiodic, taskName, 100, taskParam, APERIODIC_TASK_PRIORITY, NULL, arrival, period, duration);
-            }
-            else
-            {
-                xTaskCreatePeriodic(taskAperiodicNumber, taskName, 100, taskParam, APERIODIC_TASK_PRIORITY, NULL, arrival, period, duration);
-            }
+            return;
         }
+        complete = (previous == 1) ? pdTRUE : pdFALSE;
+        start = (previous == 0) ? pdTRUE : pdFALSE;
     }
-    else if (token[0] == 's')
+    else
     {
-        token = strtok(NULL, " ");
-        TickType_t capacity = atoi(token);
+        frameRemainingFromISR = 0;
+    }
+#endif
 
-        token = strtok(NULL, " ");
-        TickType_t period = atoi(token);
+    if (commandSkipping != pdFALSE)
+    {
+        if (start == pdFALSE || commandGap != pdFALSE)
+        {
+            return;
+        }
+        commandSkipping = pdFALSE;
+    }
 
-        initialiseServer(capacity, period);
+    if (xStreamBufferSendFromISR(commandStream, &c, 1, pxHigherPriorityTaskWoken) == 1)
+    {
+        commandBytesQueued++;
     }
-    else if (token[0] == 'c')
+    else
     {
-        token = strtok(NULL, " ");
+        commandGapAt = commandBytesQueued;
+        commandGap = pdTRUE;
+        commandSkipping = pdTRUE;
+        complete = pdTRUE;
+    }
 
-        uint8_t sp = atoi(token);
+    /* Frames and long lines may not fit in the stream, so the task is also
+    woken to drain it once it is half full. */
+    if (complete != pdFALSE || xStreamBufferBytesAvailable(commandStream) >= configCOMMAND_STREAM_SIZE / 2)
+    {
+        vTaskNotifyGiveFromISR(commandTaskHandle, pxHigherPriorityTaskWoken);
+    }
+}
 
-        uint8_t i;
+#if (configUSE_MODE_CHANGE == 1)
 
-        float multiply = 1.0;
+/* Called from the tick.  An instant is idle if no job of the running set
+was released before it and is still unfinished, and a hyperperiod boundary
+if every periodic task also releases a job at it. */
+static void modeChangeCheck(void)
+{
+    TCB_t *temp;
+    UBaseType_t i;
+    BaseType_t idle = pdTRUE;
+    BaseType_t boundary = pdTRUE;
+    TickType_t release;
 
-        TCB_t *temp;
+    if (modeChange.pending == pdFALSE || modeChange.due != pdFALSE)
+    {
+        return;
+    }
 
-        for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+    for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
+    {
+        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
+        if (temp->period > 0)
         {
-            listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[PERIODIC_TASK_PRIORITY]));
-            if (temp->period > 0)
+            release = temp->arrival + temp->cycle * temp->period;
+
+            if (release < xTickCount)
+            {
+                idle = pdFALSE;
+            }
+            if (release != xTickCount)
             {
-                multiply *= (((float)temp->duration / (float)temp->period) + 1.0);
+                boundary = pdFALSE;
             }
         }
+    }
 
-        float result = (((2.0 - multiply) / multiply) * ((float)sp));
-
-        float decimal = result - (int)result;
-        result = result - decimal;
+    for (i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY])); i++)
+    {
+        listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]));
+        if (temp->arrival < xTickCount)
+        {
+            idle = pdFALSE;
+        }
+    }
 
-        if (decimal >= 0.5)
-            result++;
+    if (modeChange.policy == tskMODE_CHANGE_HYPERPERIOD && modeChange.hyperperiod > 0 &&
+        (TickType_t)(xTickCount - modeChange.requested) <= modeChange.hyperperiod)
+    {
+        idle = (idle != pdFALSE && boundary != pdFALSE) ? pdTRUE : pdFALSE;
+    }
 
-        print_string("C:");
-        print_float(result);
-        print_string("\n");
+    if (modeChange.policy == tskMODE_CHANGE_ABORT || idle != pdFALSE)
+    {
+        modeChange.tick = xTickCount;
+        modeChange.due = pdTRUE;
+        vTaskNotifyGiveFromISR(commandTaskHandle, NULL);
     }
-    else if(token[0] == 'b'){
+}
 
-        char *k = strtok(NULL, " ");
+#endif /* configUSE_MODE_CHANGE */
 
-        char *temp = strtok(k, "-");
+static void commandTask(void *parameter)
+{
+    uint8_t length = 0;
+    BaseType_t overflow = pdFALSE;
+    uint16_t received = 0;
+    char c;
+#if (configUSE_FRAMED_COMMANDS == 1)
+    uint16_t frameRemaining = 0;
+#endif
 
-        double sum = 0;
+    (void)parameter;
 
-        BaseType_t counter = 0;
-        BaseType_t i;
+    for (;;)
+    {
+        /* Blocks until a complete line or frame is buffered, or the stream
+        needs draining, or a mode change is due. */
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-        while (temp != NULL)
+#if (configUSE_MODE_CHANGE == 1)
+        if (modeChange.due != pdFALSE)
         {
-            if (counter == MAX_TASKS_INPUT)
-                break;
+            modeChangeApply();
+        }
+#endif
 
-            if (temp[0] == 'p')
-            {
-                taskParameters[counter].taskType = PERIODIC_TASK_PRIORITY;
-            }
-            else
-            {
-                taskParameters[counter].taskType = APERIODIC_TASK_PRIORITY;
-            }
-
-            temp = strtok(NULL, "-");
-            strcpy(taskParameters[counter].taskName, temp);
-            taskParameters[counter].taskName[strlen(taskParameters[counter].taskName)] = 0;
-            char *taskFunction;
-            taskFunction = strtok(NULL, "-");
-            char *taskParam = pvPortMalloc(MAX_TASK_NAME_LENGTH * sizeof(char));
-            strcpy(taskParam, strtok(NULL, "-"));
-            temp = strtok(NULL, "-");
-            TickType_t arrival = atoi(temp) + xTaskGetTickCount();
-            temp = strtok(NULL, "-");
-            TickType_t period = atoi(temp);
-            temp = strtok(NULL, "-");
-            TickType_t duration = atoi(temp);
-            temp = strtok(NULL, "-");
-            taskParameters[counter].taskParam = taskParam;
-            taskParameters[counter].arrival = arrival;
-            taskParameters[counter].period = period;
-            taskParameters[counter].duration = duration;
-            taskParameters[counter].create = 1;
-
-                    
-            if (taskFunction[0] == 'w')
-            {
-                taskParameters[counter].taskFunction = WORD_FUNCTION;
-            }
-            else
+        for (;;)
+        {
+            /* Throw away the line or frame cut short by a full stream. */
+            if (commandGap != pdFALSE && received == commandGapAt)
             {
-                taskParameters[counter].taskFunction = NUMBER_FUNCTION;
+#if (configUSE_FRAMED_COMMANDS == 1)
+                if (framedMode != pdFALSE && frameRemaining != 0 && length > 1)
+                {
+                    sendNack((uint8_t)commandLine[1], FRAME_NACK_MALFORMED);
+                }
+                frameRemaining = 0;
+#endif
+                length = 0;
+                overflow = pdFALSE;
+                commandGap = pdFALSE;
             }
 
-            if (taskParameters[counter].taskType == PERIODIC_TASK_PRIORITY)
+            if (xStreamBufferReceive(commandStream, &c, 1, 0) != 1)
             {
-                sum += taskParameters[i].duration / (double)taskParameters[i].period;
+                break;
             }
+            received++;
 
-            counter++;
-        }
-
-        double x = counter * (pow(2, 1 / (double)counter) - 1);
-
-        if (sum > x)
-        {
-            print_string("Cant schedule");
-
-            for (i = 0; i < counter; i++)
+#if (configUSE_FRAMED_COMMANDS == 1)
+            if (framedMode != pdFALSE)
             {
-                taskParameters[i].duration = 0;
-                taskParameters[i].create = 0;
-            }
+                uint16_t previous = frameRemaining;
 
-            return;
-        }
-        for (i = 0; i < counter; i++)
-        {
-            char *name = pvPortMalloc((MAX_TASK_NAME_LENGTH + 1) * sizeof(char));
-            strcpy(name, taskParameters[i].taskName);
+                frameRemaining = frameCountByte(previous, (uint8_t)c);
 
-            if (taskParameters[i].taskType == PERIODIC_TASK_PRIORITY)
-            {
-                if (taskParameters[i].taskFunction == WORD_FUNCTION)
+                /* Bytes between frames and the sync byte are not kept; a
+                frame is stored from its length byte on. */
+                if (previous == 0)
                 {
-                    // print_string(taskParameters[i].taskName);
-                    // print_string(taskParameters[i].taskParam);
-                    // print_number(taskParameters[i].arrival);
-                    // print_number(taskParameters[i].period);
-                    // print_number(taskParameters[i].duration);
+                    length = 0;
+                    overflow = pdFALSE;
+                    continue;
+                }
 
-                    xTaskCreatePeriodic(taskPeriodic, name, 100, taskParameters[i].taskParam, PERIODIC_TASK_PRIORITY, NULL, taskParameters[i].arrival, taskParameters[i].period, taskParameters[i].duration);
+                if (length < configCOMMAND_LINE_LENGTH)
+                {
+                    commandLine[length++] = c;
                 }
                 else
                 {
-                    // print_string(taskParameters[i].taskName);
-                    // print_string(taskParameters[i].taskParam);
-                    // print_number(taskParameters[i].arrival);
-                    // print_number(taskParameters[i].period);
-                    // print_number(taskParameters[i].duration);
-                    xTaskCreatePeriodic(taskPeriodicNumber, name, 100, taskParameters[i].taskParam, PERIODIC_TASK_PRIORITY, NULL, taskParameters[i].arrival, taskParameters[i].period, taskParameters[i].duration);
+                    overflow = pdTRUE;
+                }
+
+                if (frameRemaining == 0)
+                {
+                    parseFrame((const uint8_t *)commandLine, length, overflow);
+                    length = 0;
+                    overflow = pdFALSE;
+                }
+                continue;
+            }
+            frameRemaining = 0;
+#endif
+            if (c == '\n' || c == '\r')
+            {
+                if (length > 0 && overflow == pdFALSE)
+                {
+                    commandLine[length] = 0;
+                    parseInput(commandLine);
                 }
-                taskParameters[i].create = 0;
-                taskParameters[i].duration = 0;
+                length = 0;
+                overflow = pdFALSE;
+            }
+            else if (length < configCOMMAND_LINE_LENGTH - 1)
+            {
+                commandLine[length++] = c;
+            }
+            else
+            {
+                overflow = pdTRUE;
             }
         }
     }
 }
 
+BaseType_t xCommandIntakeStart(void)
+{
+    commandStream = xStreamBufferCreate(configCOMMAND_STREAM_SIZE, 1);
+
+    if (commandStream == NULL)
+    {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+#if (configUSE_FRAMED_COMMANDS == 1)
+    frameStream = xStreamBufferCreate(configFRAME_OUTPUT_SIZE, 1);
+
+    if (frameStream == NULL)
+    {
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+#endif
+
+    /* A period of zero keeps the command task ahead of every job. */
+    return xTaskCreatePeriodic(commandTask, "cmd", configCOMMAND_TASK_STACK_SIZE, NULL, PERIODIC_TASK_PRIORITY, &commandTaskHandle, 0, 0, 0);
+}
+
 #if (INCLUDE_vTaskDelete == 1)
 
 void vTaskDelete(TaskHandle_t xTaskToDelete)
@@ -1673,6 +5669,15 @@ void vTaskDelete(TaskHandle_t xTaskToDelete)
             mtCOVERAGE_TEST_MARKER();
         }
 
+#if (configUSE_SHARED_JOB_STACK == 1)
+        if (tskSTACK_IS_SHARED(pxTCB))
+        {
+            sharedStackRemove(pxTCB);
+        }
+#endif
+
+        registryRemove(pxTCB);
+
         /* Increment the uxTaskNumber also so kernel aware debuggers can
             detect that the task lists need re-generating.  This is done before
             portPRE_TASK_DELETE_HOOK() as in the Windows port that macro will
@@ -1686,6 +5691,13 @@ void vTaskDelete(TaskHandle_t xTaskToDelete)
                 Place the task in the termination list.  The idle task will
                 check the termination list and free up any memory allocated by
                 the scheduler for the TCB and stack of the deleted task. */
+#if (configUSE_TASK_RECYCLING == 1)
+            {
+                /* Remember when the task was deleted to measure how long it
+                waits to be reclaimed. */
+                listSET_LIST_ITEM_VALUE(&(pxTCB->xStateListItem), xTickCount);
+            }
+#endif
             vListInsertEnd(&xTasksWaitingTermination, &(pxTCB->xStateListItem));
 
             /* Increment the ucTasksDeleted variable so the idle task knows
@@ -1703,7 +5715,11 @@ void vTaskDelete(TaskHandle_t xTaskToDelete)
         else
         {
             --uxCurrentNumberOfTasks;
+#if (configUSE_TASK_RECYCLING == 1)
+            reclaimTCB(pxTCB);
+#else
             prvDeleteTCB(pxTCB);
+#endif
 
             /* Reset the next expected unblock time in case it referred to
                 the task that has just been deleted. */
@@ -2587,7 +6603,9 @@ void vTaskEndScheduler(void)
 }
 /*----------------------------------------------------------*/
 
-void vTaskSuspendAll(void)
+/* The name is bracketed so the overhead profiler's vTaskSuspendAll() macro
+does not apply to the definition. */
+void(vTaskSuspendAll)(void)
 {
     /* A critical section is not required as the variable is of type
     BaseType_t.  Please read Richard Barry's reply in the following link to a
@@ -2680,6 +6698,10 @@ BaseType_t xTaskResumeAll(void)
 
         if (uxSchedulerSuspended == (UBaseType_t)pdFALSE)
         {
+#if (configUSE_OVERHEAD_PROFILER == 1)
+            overheadRecord(OVERHEAD_SUSPEND);
+#endif
+
             if (uxCurrentNumberOfTasks > (UBaseType_t)0U)
             {
                 /* Move any readied tasks from the pending list into the
@@ -3323,26 +7345,18 @@ BaseType_t xTaskIncrementTick(void)
 
     for (i = 0; i < MAX_REFILLS; i++)
     {
-        if (refills[i].refillTick == xTickCount)
+        if (refills[i].refillTick == xTickCount && refills[i].refillAmount > 0)
         {
+            traceSERVER_REFILL(refills[i].refillAmount);
             serverCapacity += refills[i].refillAmount;
             refills[i].refillAmount = 0;
-            print_string("R:");
-            // print_number(refills[i].refillAmount);
-            // print_string("-");
-            print_number(xTickCount);
-            print_string("\n");
-        }
-    }
-    
-    // for (i = 0; i < MAX_TASKS_INPUT; i++)
-    // {
-    //     if(taskParameters[i].create == 1){
-    //         // xTaskCreatePeriodic(taskAperiodic, "kara", 100, "pica", APERIODIC_TASK_PRIORITY, NULL, 10, 0, 2);            
-    //         taskParameters[i].create = 1;
-    //     }
-    // }
-    
+            refillNoticePost(xTickCount);
+        }
+    }
+
+#if (configUSE_MODE_CHANGE == 1)
+    modeChangeCheck();
+#endif
 
     return pdTRUE;
 }
@@ -3471,6 +7485,22 @@ void vTaskSwitchContext(void)
         xYieldPending = pdFALSE;
         traceTASK_SWITCHED_OUT();
 
+#if (configUSE_OVERHEAD_PROFILER == 1)
+        overheadSwitchOut(pxCurrentTCB);
+#endif
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+        {
+            ulTotalRunTime = portGET_RUN_TIME_COUNTER_VALUE();
+
+            /* Charge the time since the last switch to the task leaving the
+            processor and to its class. */
+            pxCurrentTCB->ulRunTimeCounter += ulTotalRunTime - ulTaskSwitchedInTime;
+            runTimeClasses[runTimeClass(pxCurrentTCB)] += ulTotalRunTime - ulTaskSwitchedInTime;
+            ulTaskSwitchedInTime = ulTotalRunTime;
+        }
+#endif /* configGENERATE_RUN_TIME_STATS */
+
         /* Check for stack overflow, if configured. */
         taskCHECK_FOR_STACK_OVERFLOW();
 
@@ -3482,6 +7512,16 @@ void vTaskSwitchContext(void)
 
         TCB_t *minTask = xIdleTaskHandle;
 
+#if (configUSE_SHARED_JOB_STACK == 1)
+        /* A finished job leaves the shared stack before the next job is
+        chosen, so it no longer holds the preemption level. */
+        if (restartTask != NULL && tskSTACK_IS_SHARED(restartTask))
+        {
+            sharedStackRemove(restartTask);
+            restartTask = NULL;
+        }
+#endif
+
         for (int i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[PERIODIC_TASK_PRIORITY])); i++)
         {
 
@@ -3489,6 +7529,12 @@ void vTaskSwitchContext(void)
 
             if (temp->period < minPeriod && temp->arrival + temp->cycle * temp->period <= xTickCount)
             {
+#if (configUSE_SHARED_JOB_STACK == 1)
+                if (tskSTACK_IS_SHARED(temp) && temp->jobStarted == 0 && sharedStackCanStart(temp) == pdFALSE)
+                {
+                    continue;
+                }
+#endif
                 minTask = temp;
                 minPeriod = temp->period;
             }
@@ -3496,27 +7542,44 @@ void vTaskSwitchContext(void)
 
         if (serverCapacity > 0 && serverPeriod < minPeriod)
         {
-            for (int i = 0; i < listCURRENT_LIST_LENGTH(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY])); i++)
-            {
+            /* The server takes jobs in order of arrival, so the walk starts
+            at the head of the list each time rather than where the last one
+            stopped. */
+            const ListItem_t *item;
+            TCB_t *earliest = NULL;
 
-                listGET_OWNER_OF_NEXT_ENTRY(temp, &(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]));
+            for (item = listGET_HEAD_ENTRY(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]));
+                 item != listGET_END_MARKER(&(pxReadyTasksLists[APERIODIC_TASK_PRIORITY]));
+                 item = listGET_NEXT(item))
+            {
+                temp = (TCB_t *)listGET_LIST_ITEM_OWNER(item);
 
-                if (temp->arrival <= xTickCount)
+                if (temp->arrival <= xTickCount && (earliest == NULL || temp->arrival < earliest->arrival))
                 {
+                    earliest = temp;
+                }
+            }
 
-                    if (temp->cycle == 0)
-                    {
-                        setRefill(temp->duration);
-                        temp->cycle = 1;
-                    }
-                    minTask = temp;
-                    break;
+            if (earliest != NULL)
+            {
+                if (earliest->cycle == 0)
+                {
+                    setRefill(earliest->duration);
+                    earliest->cycle = 1;
                 }
+                minTask = earliest;
             }
         }
 
         pxCurrentTCB = minTask;
 
+#if (configUSE_SHARED_JOB_STACK == 1)
+        if (tskSTACK_IS_SHARED(pxCurrentTCB) && pxCurrentTCB->jobStarted == 0)
+        {
+            sharedStackStart(pxCurrentTCB);
+        }
+#endif
+
         if (restartTask != NULL)
         {
             restartTask->pxTopOfStack = pxPortInitialiseStack(&(restartTask->pxStack[restartTask->stackDepth - (configSTACK_DEPTH_TYPE)1]), restartTask->taskCode, restartTask->pvParameters);
@@ -3524,6 +7587,10 @@ void vTaskSwitchContext(void)
             restartTask = NULL;
         }
 
+#if (configUSE_OVERHEAD_PROFILER == 1)
+        overheadSwitchIn(pxCurrentTCB);
+#endif
+
         traceTASK_SWITCHED_IN();
     }
 }
@@ -3861,6 +7928,30 @@ static portTASK_FUNCTION(prvIdleTask, pvParameters)
         is responsible for freeing the deleted task's TCB and stack. */
         prvCheckTasksWaitingTermination();
 
+#if (configUSE_FRAMED_COMMANDS == 1)
+        /* Write out the frames the command task has queued, and only print
+        anything else between whole frames. */
+        if (frameOutputDrain() != pdFALSE)
+#endif
+        {
+#if (configUSE_TRACE_BUFFER == 1)
+            /* Print job output queued since the last pass. */
+            traceBufferDrain();
+#endif
+
+            /* Print the server refills the tick interrupt has queued. */
+            refillNoticesDrain();
+        }
+
+        /* Time the CPU burn job kernel while nothing else wants to run. */
+        jobCalibrate();
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+        runTimeCalibrate();
+#endif
+
+        portSPIN_WAIT();
+
 #if (configUSE_PREEMPTION == 0)
         {
             /* If we are not using preemption we keep forcing a task switch to
@@ -4066,6 +8157,8 @@ static void prvInitialiseTaskLists(void)
     vListInitialise(&xDelayedTaskList1);
     vListInitialise(&xDelayedTaskList2);
     vListInitialise(&xPendingReadyList);
+    vListInitialise(&xBatchTasks);
+    registryInitialise();
 
 #if (INCLUDE_vTaskDelete == 1)
     {
@@ -4073,6 +8166,12 @@ static void prvInitialiseTaskLists(void)
     }
 #endif /* INCLUDE_vTaskDelete */
 
+#if (configUSE_TASK_RECYCLING == 1)
+    {
+        vListInitialise(&xRecycledTasks);
+    }
+#endif /* configUSE_TASK_RECYCLING */
+
 #if (INCLUDE_vTaskSuspend == 1)
     {
         vListInitialise(&xSuspendedTaskList);
@@ -4095,6 +8194,27 @@ static void prvCheckTasksWaitingTermination(void)
     {
         TCB_t *pxTCB;
 
+#if (configUSE_TASK_RECYCLING == 1)
+        /* Reclaim a bounded batch per pass so loop() is not held off under
+        heavy task churn.  Anything left is picked up on the next pass, or
+        reused directly by xTaskCreatePeriodic(). */
+        UBaseType_t uxBatch = 0;
+
+        while (uxDeletedTasksWaitingCleanUp > (UBaseType_t)0U && uxBatch++ < (UBaseType_t)configTASK_RECLAIM_BATCH)
+        {
+            taskENTER_CRITICAL();
+            {
+                pxTCB = listGET_OWNER_OF_HEAD_ENTRY((&xTasksWaitingTermination));
+                (void)uxListRemove(&(pxTCB->xStateListItem));
+                recordReclaimLatency(pxTCB);
+                --uxCurrentNumberOfTasks;
+                --uxDeletedTasksWaitingCleanUp;
+            }
+            taskEXIT_CRITICAL();
+
+            reclaimTCB(pxTCB);
+        }
+#else
         /* uxDeletedTasksWaitingCleanUp is used to prevent taskENTER_CRITICAL()
         being called too often in the idle task. */
         while (uxDeletedTasksWaitingCleanUp > (UBaseType_t)0U)
@@ -4110,6 +8230,7 @@ static void prvCheckTasksWaitingTermination(void)
 
             prvDeleteTCB(pxTCB);
         }
+#endif /* configUSE_TASK_RECYCLING */
     }
 #endif /* INCLUDE_vTaskDelete */
 }
@@ -4336,6 +8457,8 @@ static void prvDeleteTCB(TCB_t *pxTCB)
         want to allocate and clean RAM statically. */
     portCLEAN_UP_TCB(pxTCB);
 
+    releaseJobStrings(pxTCB);
+
 /* Free up the memory allocated by the scheduler for the task.  It is up
         to the task to free any memory allocated at the application level. */
 #if (configUSE_NEWLIB_REENTRANT == 1)
@@ -4347,8 +8470,11 @@ static void prvDeleteTCB(TCB_t *pxTCB)
 #if ((configSUPPORT_DYNAMIC_ALLOCATION == 1) && (configSUPPORT_STATIC_ALLOCATION == 0) && (portUSING_MPU_WRAPPERS == 0))
     {
         /* The task can only have been allocated dynamically - free both
-            the stack and TCB. */
-        vPortFree(pxTCB->pxStack);
+            the stack and TCB.  The shared job stack is never freed. */
+        if (tskSTACK_IS_SHARED(pxTCB) == pdFALSE)
+        {
+            vPortFree(pxTCB->pxStack);
+        }
         vPortFree(pxTCB);
     }
 #elif (tskSTATIC_AND_DYNAMIC_ALLOCATION_POSSIBLE != 0) /*lint !e731 !e9029 Macro has been consolidated for readability reasons. */